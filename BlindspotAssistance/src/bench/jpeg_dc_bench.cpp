@@ -0,0 +1,124 @@
+// Checks the DC thumbnails of decodeJpegDc against the 8x8 block means of a
+// full decode, for frames with and without DHT segments as MJPEG cameras send
+// them, and that a malformed Huffman table is rejected. Then compares the
+// speed of both decodes.
+// Usage: jpeg_dc_bench [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "jpeg_dc.hpp"
+
+namespace {
+// The thumbnail rounds the quantized DC, the full decode rounds every sample
+const int MaxMeanError = 3;
+
+// Synthetic camera frame: gradients with a few sharp edges, so AC codes of every length occur
+cv::Mat makeFrame() {
+    cv::Mat frame(480, 640, CV_8UC3);
+    for (int y = 0; y < frame.rows; ++y) {
+        for (int x = 0; x < frame.cols; ++x) {
+            frame.at<cv::Vec3b>(y, x) = cv::Vec3b(static_cast<uchar>(x * 255 / frame.cols),
+                                                  static_cast<uchar>(y * 255 / frame.rows),
+                                                  static_cast<uchar>((x ^ y) & 0xFF));
+        }
+    }
+    cv::rectangle(frame, cv::Rect(100, 80, 200, 150), cv::Scalar(20, 200, 90), cv::FILLED);
+    cv::circle(frame, cv::Point(450, 300), 90, cv::Scalar(240, 30, 30), cv::FILLED);
+    return frame;
+}
+
+// The frame with every DHT segment removed
+std::vector<uchar> stripHuffmanTables(const std::vector<uchar>& jpeg) {
+    std::vector<uchar> stripped(jpeg.begin(), jpeg.begin() + 2);
+    std::size_t p = 2;
+    while (p + 4 <= jpeg.size() && 0xFF == jpeg[p] && 0xDA != jpeg[p + 1]) {
+        const std::size_t length = jpeg[p + 2] * 256u + jpeg[p + 3];
+        if (0xC4 != jpeg[p + 1]) {
+            stripped.insert(stripped.end(), jpeg.begin() + p, jpeg.begin() + p + 2 + length);
+        }
+        p += 2 + length;
+    }
+    stripped.insert(stripped.end(), jpeg.begin() + p, jpeg.end());
+    return stripped;
+}
+
+// The first DHT claims three 1-bit codes, taken from its 3-bit codes so the symbol count still fits
+std::vector<uchar> corruptHuffmanTable(const std::vector<uchar>& jpeg) {
+    std::vector<uchar> corrupt = jpeg;
+    for (std::size_t p = 2; p + 8 <= corrupt.size() && 0xFF == corrupt[p]; p += 2 + corrupt[p + 2] * 256u + corrupt[p + 3]) {
+        if (0xC4 == corrupt[p + 1] && corrupt[p + 7] >= 3) {
+            corrupt[p + 5] = static_cast<uchar>(corrupt[p + 5] + 3);
+            corrupt[p + 7] = static_cast<uchar>(corrupt[p + 7] - 3);
+            break;
+        }
+    }
+    return corrupt;
+}
+
+bool check(const char* name, const std::vector<uchar>& jpeg, const cv::Mat& luma) {
+    JpegDcThumbnail thumbnail;
+    if (!decodeJpegDc(jpeg.data(), jpeg.size(), thumbnail)) {
+        std::cout << name << ": not decoded" << std::endl;
+        return false;
+    }
+    if (thumbnail.width != (luma.cols + 7) / 8 || thumbnail.height != (luma.rows + 7) / 8) {
+        std::cout << name << ": thumbnail is " << thumbnail.width << "x" << thumbnail.height << std::endl;
+        return false;
+    }
+    int maxError = 0;
+    for (int by = 0; by < luma.rows / 8; ++by) {
+        for (int bx = 0; bx < luma.cols / 8; ++bx) {
+            const int mean = static_cast<int>(cv::mean(luma(cv::Rect(bx * 8, by * 8, 8, 8)))[0] + 0.5);
+            maxError = std::max(maxError, std::abs(mean - thumbnail.values[by * thumbnail.width + bx]));
+        }
+    }
+    std::cout << name << ": largest block mean error " << maxError << std::endl;
+    return maxError <= MaxMeanError;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+    if (iterations <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [iterations]" << std::endl;
+        return 2;
+    }
+
+    std::vector<uchar> jpeg;
+    cv::imencode(".jpg", makeFrame(), jpeg, {cv::IMWRITE_JPEG_QUALITY, 85});
+    const std::vector<uchar> noTables = stripHuffmanTables(jpeg);
+    // A grayscale decode returns the Y component the thumbnail is made of
+    const cv::Mat luma = cv::imdecode(jpeg, cv::IMREAD_GRAYSCALE);
+
+    bool ok = check("with DHT", jpeg, luma);
+    ok = check("without DHT", noTables, luma) && ok;
+    JpegDcThumbnail thumbnail;
+    const std::vector<uchar> corrupt = corruptHuffmanTable(jpeg);
+    if (decodeJpegDc(corrupt.data(), corrupt.size(), thumbnail)) {
+        std::cout << "corrupt DHT: accepted" << std::endl;
+        ok = false;
+    } else {
+        std::cout << "corrupt DHT: rejected" << std::endl;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        decodeJpegDc(noTables.data(), noTables.size(), thumbnail);
+    }
+    const double dcMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        cv::imdecode(jpeg, cv::IMREAD_COLOR);
+    }
+    const double fullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    std::cout << std::fixed << std::setprecision(3) << "DC thumbnail " << dcMs << "ms, full decode " << fullMs
+              << "ms per 640x480 frame" << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+// Checks every hwcToPlanar kernel of this CPU byte for byte against the
+// per-pixel loop it replaced and compares their speed.
+// Usage: preprocess_bench [iterations]
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "preprocess.hpp"
+
+namespace {
+// The conversion IEGraph used before hwcToPlanar
+void loadImgToIEGraph(const cv::Mat& img, size_t batch, void* ieBuffer) {
+    const int channels = img.channels();
+    const int height = img.rows;
+    const int width = img.cols;
+
+    float* ieData = reinterpret_cast<float*>(ieBuffer);
+    int bOffset = static_cast<int>(batch) * channels * width * height;
+    for (int c = 0; c < channels; c++) {
+        int cOffset = c * width * height;
+        for (int w = 0; w < width; w++) {
+            for (int h = 0; h < height; h++) {
+                ieData[bOffset + cOffset + h * width + w] =
+                        static_cast<float>(img.at<cv::Vec3b>(h, w)[c]);
+            }
+        }
+    }
+}
+
+template <typename F>
+double millisecondsPerRun(int iterations, F func) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        func();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+    if (iterations <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [iterations]" << std::endl;
+        return 2;
+    }
+
+    // Network input sizes, a camera frame and an odd width inside a padded image
+    const cv::Size sizes[] = {{672, 384}, {640, 480}, {1280, 720}, {333, 211}};
+    cv::RNG rng(12345);
+    bool exact = true;
+    std::cout << std::fixed << std::setprecision(3);
+    for (auto& size : sizes) {
+        cv::Mat padded(size.height + 3, size.width + 37, CV_8UC3);
+        rng.fill(padded, cv::RNG::UNIFORM, 0, 256);
+        const cv::Mat img = padded(cv::Rect(5, 1, size.width, size.height));
+
+        const std::size_t count = 3 * static_cast<std::size_t>(size.area());
+        std::vector<float> expected(count);
+        std::vector<float> actual(count);
+        loadImgToIEGraph(img, 0, expected.data());
+        const double referenceTime = millisecondsPerRun(iterations, [&]() { loadImgToIEGraph(img, 0, expected.data()); });
+        std::cout << size.width << "x" << size.height << ": per-pixel loop " << referenceTime << " ms" << std::endl;
+
+        for (auto& isa : hwcToPlanarIsas()) {
+            std::fill(actual.begin(), actual.end(), -1.0f);
+            hwcToPlanar(img, actual.data(), isa);
+            const bool same = 0 == std::memcmp(expected.data(), actual.data(), count * sizeof(float));
+            exact = exact && same;
+            const double time = millisecondsPerRun(iterations, [&]() { hwcToPlanar(img, actual.data(), isa); });
+            std::cout << "    " << std::setw(8) << std::left << isa << std::right << " " << time << " ms, "
+                      << referenceTime / time << "x, " << (same ? "bit-exact" : "MISMATCH") << std::endl;
+        }
+    }
+    return exact ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+// Compares the wakeup latency of BlockingRing with the mutex/condvar queues
+// IEGraph used before it. Like the request queues, nireq tokens circulate
+// between a producer thread, which takes an available token and "prepares a
+// batch", and the main thread, which takes a busy token and "collects the
+// result". Preparing is the slower side, so the main thread waits for every
+// token and the time from its push to the returning pop is the wakeup latency.
+// Usage: ring_bench [rounds per nireq] [prepare us] [collect us]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "blocking_ring.hpp"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Token {
+    Clock::time_point pushed;
+};
+
+// The queue with its own mutex and condition variable, as IEGraph had them
+class CondVarQueue {
+    std::queue<Token> queue;
+    std::mutex mutex;
+    std::condition_variable condVar;
+
+public:
+    explicit CondVarQueue(std::size_t) {}
+
+    void push(const Token& token) {
+        std::unique_lock<std::mutex> lock(mutex);
+        queue.push(token);
+        lock.unlock();
+        condVar.notify_one();
+    }
+
+    void pop(Token& token) {
+        std::unique_lock<std::mutex> lock(mutex);
+        condVar.wait(lock, [this]() { return !queue.empty(); });
+        token = queue.front();
+        queue.pop();
+    }
+};
+
+class RingQueue {
+    BlockingRing<Token> ring;
+
+public:
+    explicit RingQueue(std::size_t capacity): ring(capacity) {}
+
+    void push(const Token& token) {
+        ring.tryPush(token);
+    }
+
+    void pop(Token& token) {
+        ring.pop(token, []() { return false; });
+    }
+};
+
+void spinFor(std::chrono::microseconds duration) {
+    const auto end = Clock::now() + duration;
+    while (Clock::now() < end) {
+    }
+}
+
+struct Result {
+    float median;  // us
+    float p99;     // us
+    float rate;    // tokens per second through the main thread
+};
+
+template <typename Queue>
+Result run(std::size_t nireq, std::size_t rounds, std::chrono::microseconds prepare, std::chrono::microseconds collect) {
+    Queue available(nireq);
+    Queue busy(nireq);
+    for (std::size_t i = 0; i < nireq; ++i) {
+        available.push(Token());
+    }
+    const std::size_t total = rounds * nireq;
+
+    std::thread producer([&]() {
+        for (std::size_t i = 0; i < total; ++i) {
+            Token token;
+            available.pop(token);
+            spinFor(prepare);
+            token.pushed = Clock::now();
+            busy.push(token);
+        }
+    });
+
+    std::vector<float> latencies;
+    latencies.reserve(total);
+    const auto start = Clock::now();
+    for (std::size_t i = 0; i < total; ++i) {
+        Token token;
+        busy.pop(token);
+        latencies.push_back(std::chrono::duration<float, std::micro>(Clock::now() - token.pushed).count());
+        spinFor(collect);
+        available.push(token);
+    }
+    const float seconds = std::chrono::duration<float>(Clock::now() - start).count();
+    producer.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    return {latencies[latencies.size() / 2], latencies[(latencies.size() * 99) / 100], static_cast<float>(total) / seconds};
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const long rounds = argc > 1 ? std::atol(argv[1]) : 2000;
+    const long prepareUs = argc > 2 ? std::atol(argv[2]) : 50;
+    const long collectUs = argc > 3 ? std::atol(argv[3]) : 10;
+    if (rounds <= 0 || prepareUs < 0 || collectUs < 0) {
+        std::cerr << "Usage: " << argv[0] << " [rounds per nireq] [prepare us] [collect us]" << std::endl;
+        return 2;
+    }
+    const std::chrono::microseconds prepare(prepareUs);
+    const std::chrono::microseconds collect(collectUs);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "nireq   condvar median/p99 us  tokens/s   ring median/p99 us  tokens/s" << std::endl;
+    for (std::size_t nireq = 1; nireq <= 16; ++nireq) {
+        auto condVar = run<CondVarQueue>(nireq, static_cast<std::size_t>(rounds), prepare, collect);
+        auto ring = run<RingQueue>(nireq, static_cast<std::size_t>(rounds), prepare, collect);
+        std::cout << std::setw(5) << nireq
+                  << std::setw(14) << condVar.median << "/" << std::setw(7) << condVar.p99
+                  << std::setw(10) << condVar.rate
+                  << std::setw(13) << ring.median << "/" << std::setw(7) << ring.p99
+                  << std::setw(10) << ring.rate << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+// Measures what tracking between detector keyframes costs in accuracy and
+// gains in speed. A video is run through IEGraph once with the detector on
+// every frame and once on every Nth frame with the tracker in between, the
+// same way the demo does with -det_interval. For the second run it reports
+// the share of the detector's boxes that a tracked box of the same label
+// covers with an IoU of at least 0.5.
+// Usage: tracker_bench <model.xml> <video> [interval] [device] [max frames]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "graph.hpp"
+#include "tracker.hpp"
+
+namespace {
+const float ConfidenceThreshold = 0.5f;
+const float MatchIou = 0.5f;
+
+using Boxes = std::vector<MultiObjectTracker::Object>;
+
+struct Run {
+    float fps = 0.0f;
+    std::vector<Boxes> boxes;  // per frame in read order
+};
+
+Run run(const std::string& model, const std::string& device, const std::vector<cv::Mat>& frames, std::size_t interval) {
+    IEGraph::InitParams params;
+    params.batchSize = 1;
+    params.maxRequests = 1;
+    params.trackedFrames = interval > 1;
+    params.modelPath = model;
+    params.deviceName = device;
+    IEGraph graph(params);
+
+    std::size_t next = 0;
+    const auto start = std::chrono::steady_clock::now();
+    graph.start([&](VideoFrame& img, std::size_t, FrameDeadline) {
+        if (next == frames.size()) {
+            return FrameStatus::Finished;
+        }
+        img.frame = frames[next];
+        img.sourceIdx = 0;
+        img.infer = 0 == next % interval;
+        ++next;
+        return FrameStatus::Ready;
+    }, [](InferenceEngine::InferRequest::Ptr req, const std::vector<std::string>& outputDataBlobNames, cv::Size,
+          const std::vector<std::shared_ptr<VideoFrame>>& batch) {
+        auto output = req->GetBlob(outputDataBlobNames[0]);
+        float* data = output->buffer();
+        std::size_t total = 1;
+        for (auto v : output->getTensorDesc().getDims()) {
+            total *= v;
+        }
+        for (auto& f : batch) {
+            f->detections.set(new Boxes);
+        }
+        for (std::size_t i = 0; i + 7 <= total; i += 7) {
+            const int idxInBatch = static_cast<int>(data[i]);
+            if (data[i + 2] <= ConfidenceThreshold || idxInBatch < 0 ||
+                static_cast<std::size_t>(idxInBatch) >= batch.size()) {
+                continue;
+            }
+            MultiObjectTracker::Object object;
+            const float x0 = std::min(std::max(0.0f, data[i + 3]), 1.0f);
+            const float y0 = std::min(std::max(0.0f, data[i + 4]), 1.0f);
+            const float x1 = std::min(std::max(0.0f, data[i + 5]), 1.0f);
+            const float y1 = std::min(std::max(0.0f, data[i + 6]), 1.0f);
+            object.rect = cv::Rect2f(x0, y0, x1 - x0, y1 - y0);
+            object.label = static_cast<int>(data[i + 1]);
+            object.confidence = data[i + 2];
+            batch[idxInBatch]->detections.get<Boxes>().push_back(object);
+        }
+    });
+
+    // The tracker settings of the demo
+    MultiObjectTracker tracker(0.3f, 2);
+    Run result;
+    while (true) {
+        auto batch = graph.getBatchData(cv::Size());
+        if (batch.empty()) {
+            break;
+        }
+        for (auto& frame : batch) {
+            Boxes objects;
+            if (frame->infer) {
+                objects = frame->detections.get<Boxes>();
+                if (interval > 1) {
+                    tracker.correct(objects);
+                }
+            } else {
+                tracker.predict(objects);
+            }
+            result.boxes.push_back(std::move(objects));
+        }
+    }
+    const float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    result.fps = static_cast<float>(result.boxes.size()) / seconds;
+    return result;
+}
+
+float iou(const cv::Rect2f& a, const cv::Rect2f& b) {
+    const float intersection = (a & b).area();
+    const float area = a.area() + b.area() - intersection;
+    return area > 0.0f ? intersection / area : 0.0f;
+}
+
+// Detector boxes of a frame that a box of the same label matches one to one
+std::size_t matched(const Boxes& reference, const Boxes& boxes) {
+    std::vector<bool> used(boxes.size(), false);
+    std::size_t count = 0;
+    for (auto& ref : reference) {
+        std::size_t best = boxes.size();
+        float bestIou = MatchIou;
+        for (std::size_t i = 0; i < boxes.size(); ++i) {
+            const float overlap = iou(ref.rect, boxes[i].rect);
+            if (!used[i] && boxes[i].label == ref.label && overlap >= bestIou) {
+                best = i;
+                bestIou = overlap;
+            }
+        }
+        if (best != boxes.size()) {
+            used[best] = true;
+            ++count;
+        }
+    }
+    return count;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <model.xml> <video> [interval] [device] [max frames]" << std::endl;
+        return 2;
+    }
+    const std::string model = argv[1];
+    const std::string video = argv[2];
+    const long interval = argc > 3 ? std::atol(argv[3]) : 5;
+    const std::string device = argc > 4 ? argv[4] : "CPU";
+    const long maxFrames = argc > 5 ? std::atol(argv[5]) : 300;
+    if (interval < 2 || maxFrames <= 0) {
+        std::cerr << "Usage: " << argv[0] << " <model.xml> <video> [interval] [device] [max frames]" << std::endl;
+        return 2;
+    }
+
+    // Decoded up front so both runs see the same frames and decoding is not timed
+    cv::VideoCapture capture(video);
+    if (!capture.isOpened()) {
+        std::cerr << "Cannot open " << video << std::endl;
+        return 1;
+    }
+    std::vector<cv::Mat> frames;
+    cv::Mat frame;
+    while (frames.size() < static_cast<std::size_t>(maxFrames) && capture.read(frame)) {
+        frames.push_back(frame.clone());
+    }
+    if (frames.empty()) {
+        std::cerr << "No frames in " << video << std::endl;
+        return 1;
+    }
+
+    try {
+        const Run reference = run(model, device, frames, 1);
+        const Run tracked = run(model, device, frames, static_cast<std::size_t>(interval));
+        if (reference.boxes.size() != frames.size() || tracked.boxes.size() != frames.size()) {
+            std::cerr << "Not every frame came back from the pipeline" << std::endl;
+            return 1;
+        }
+
+        std::size_t detected = 0;
+        std::size_t found = 0;
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            if (0 != i % static_cast<std::size_t>(interval)) {
+                detected += reference.boxes[i].size();
+                found += matched(reference.boxes[i], tracked.boxes[i]);
+            }
+        }
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << frames.size() << " frames of " << video << std::endl;
+        std::cout << "det_interval 1: " << reference.fps << " fps" << std::endl;
+        std::cout << "det_interval " << interval << ": " << tracked.fps << " fps, recall of tracked boxes "
+                  << (detected > 0 ? 100.0f * static_cast<float>(found) / static_cast<float>(detected) : 100.0f)
+                  << "% (" << found << "/" << detected << ")" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
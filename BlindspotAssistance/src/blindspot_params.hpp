@@ -9,5 +9,15 @@
 #include <gflags/gflags.h>
 
 static const char thresh_output_message[] = "Optional. Probability threshold for detections";
+static const char roi_motion_message[] = "Optional. Infer a camera's frame only if the gray level of some pixels in its "
+                                         "detection area changed by more than this (0-255) since its last inferred frame. "
+                                         "0 infers every frame.";
+static const char det_interval_message[] = "Optional. Run the detector on every Nth frame of a camera and track the objects "
+                                           "in between. The interval is shortened for fast objects and on the highway and "
+                                           "doubled when parked. 1 detects on every frame.";
+static const char roi_refresh_message[] = "Optional. With -roi_motion, infer at least every Nth frame of a camera. 0 disables it.";
 
-DEFINE_double(t, 0.5, thresh_output_message);
\ No newline at end of file
+DEFINE_double(t, 0.5, thresh_output_message);
+DEFINE_double(roi_motion, 0.0, roi_motion_message);
+DEFINE_uint32(roi_refresh, 30, roi_refresh_message);
+DEFINE_uint32(det_interval, 1, det_interval_message);
\ No newline at end of file
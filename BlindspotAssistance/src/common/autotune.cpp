@@ -0,0 +1,193 @@
+#include "autotune.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <samples/slog.hpp>
+
+namespace {
+const std::size_t MaxPasses = 3;
+// A configuration replaces the best one only if it is faster by more than the measurement noise
+const float MinImprovement = 1.02f;
+
+const std::size_t BatchSizes[] = {1, 2, 4, 8};
+const std::size_t Requests[] = {2, 4, 6, 8, 12};
+const std::size_t InputQueueSizes[] = {1, 2, 5, 10};
+const std::size_t Streams[] = {0, 1, 2, 4, 8};
+
+float percentile(std::vector<float>& values, float share) {
+    if (values.empty()) {
+        return 0.0f;
+    }
+    // Nearest rank, so a single slow frame among a hundred is the p99
+    const auto rank = static_cast<std::size_t>(std::ceil(share * static_cast<float>(values.size())));
+    auto nth = values.begin() + static_cast<std::ptrdiff_t>(std::max<std::size_t>(rank, 1) - 1);
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+}  // namespace
+
+std::string TuneConfig::flags() const {
+    std::ostringstream stream;
+    stream << "-bs " << batchSize << " -nireq " << requests << " -n_iqs " << inputQueueSize;
+    if (0 != streams) {
+        stream << " -nstreams " << streams;
+    }
+    return stream.str();
+}
+
+AutoTuner::AutoTuner(const TuneConfig& start_, bool tuneStreams_, TrialFunc trial_):
+    start(start_), tuneStreams(tuneStreams_), trial(std::move(trial_)) {
+    if (nullptr == trial) {
+        throw std::logic_error("Auto tuner needs a trial function");
+    }
+}
+
+const TuneResult* AutoTuner::measure(const TuneConfig& config) {
+    for (auto& result : results) {
+        if (result.config == config) {
+            return &result;
+        }
+    }
+    if (std::find(failed.begin(), failed.end(), config) != failed.end()) {
+        return nullptr;
+    }
+    slog::info << "Auto tuning: trying " << config.flags() << slog::endl;
+    TuneResult result;
+    result.config = config;
+    if (!trial(config, result)) {
+        slog::warn << "Auto tuning: " << config.flags() << " failed" << slog::endl;
+        failed.push_back(config);
+        return nullptr;
+    }
+    slog::info << "Auto tuning: " << config.flags() << " gives " << result.fps << " fps, p99 latency "
+               << result.p99Latency << "ms" << slog::endl;
+    results.push_back(result);
+    return &results.back();
+}
+
+void AutoTuner::run() {
+    const TuneResult* first = measure(start);
+    if (nullptr == first) {
+        throw std::runtime_error("The pipeline does not run with the initial configuration " + start.flags());
+    }
+    TuneResult best = *first;
+
+    struct Dimension {
+        std::size_t TuneConfig::*field;
+        std::vector<std::size_t> candidates;
+    };
+    std::vector<Dimension> dimensions = {
+        {&TuneConfig::batchSize, {std::begin(BatchSizes), std::end(BatchSizes)}},
+        {&TuneConfig::requests, {std::begin(Requests), std::end(Requests)}},
+        {&TuneConfig::inputQueueSize, {std::begin(InputQueueSizes), std::end(InputQueueSizes)}},
+    };
+    if (tuneStreams) {
+        dimensions.push_back({&TuneConfig::streams, {std::begin(Streams), std::end(Streams)}});
+    }
+
+    for (std::size_t pass = 0; pass < MaxPasses; ++pass) {
+        bool improved = false;
+        for (auto& dimension : dimensions) {
+            for (auto value : dimension.candidates) {
+                TuneConfig config = best.config;
+                config.*dimension.field = value;
+                const TuneResult* result = measure(config);
+                if (nullptr != result && result->fps > best.fps * MinImprovement) {
+                    best = *result;
+                    improved = true;
+                }
+            }
+        }
+        if (!improved) {
+            break;
+        }
+    }
+}
+
+std::vector<TuneResult> AutoTuner::paretoFront() const {
+    std::vector<TuneResult> front;
+    for (auto& candidate : results) {
+        bool dominated = std::any_of(results.begin(), results.end(), [&candidate](const TuneResult& other) {
+            return other.fps >= candidate.fps && other.p99Latency <= candidate.p99Latency &&
+                   (other.fps > candidate.fps || other.p99Latency < candidate.p99Latency);
+        });
+        if (!dominated) {
+            front.push_back(candidate);
+        }
+    }
+    std::sort(front.begin(), front.end(), [](const TuneResult& a, const TuneResult& b) { return a.fps > b.fps; });
+    return front;
+}
+
+void AutoTuner::writeReport(const std::string& path, const std::vector<TuneResult>& results) {
+    std::ofstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+    file << std::fixed << std::setprecision(1);
+    file << "{\n  \"configurations\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        auto& result = results[i];
+        file << (0 == i ? "\n" : ",\n");
+        file << "    {\"fps\": " << result.fps << ", \"p99_latency_ms\": " << result.p99Latency
+             << ", \"bs\": " << result.config.batchSize << ", \"nireq\": " << result.config.requests
+             << ", \"n_iqs\": " << result.config.inputQueueSize << ", \"nstreams\": " << result.config.streams
+             << ", \"flags\": \"" << result.config.flags() << "\"}";
+    }
+    file << "\n  ]\n}\n";
+}
+
+bool runTrialProcess(const std::vector<std::string>& args, const std::string& reportPath, TuneResult& result) {
+    std::remove(reportPath.c_str());
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("Cannot start a trial process");
+    }
+    if (0 == pid) {
+        execv("/proc/self/exe", argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || 0 != WEXITSTATUS(status)) {
+        return false;
+    }
+
+    std::ifstream report(reportPath);
+    float fps = 0.0f;
+    float p99Latency = 0.0f;
+    if (!(report >> fps >> p99Latency) || !(fps > 0.0f)) {
+        return false;
+    }
+    report.close();
+    std::remove(reportPath.c_str());
+    result.fps = fps;
+    result.p99Latency = p99Latency;
+    return true;
+}
+
+void writeTrialReport(const std::string& path, float fps, std::vector<float>& latencies) {
+    std::ofstream report(path);
+    if (!report) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+    report << fps << ' ' << percentile(latencies, 0.99f) << '\n';
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct TuneConfig {
+    std::size_t batchSize = 1;
+    std::size_t requests = 1;
+    std::size_t inputQueueSize = 1;
+    std::size_t streams = 0;  // CPU throughput streams, 0 leaves them to the plugin
+
+    bool operator==(const TuneConfig& other) const {
+        return batchSize == other.batchSize && requests == other.requests &&
+               inputQueueSize == other.inputQueueSize && streams == other.streams;
+    }
+
+    // Command line flags selecting this configuration
+    std::string flags() const;
+};
+
+struct TuneResult {
+    TuneConfig config;
+    float fps = 0.0f;
+    float p99Latency = 0.0f;  // ms from capturing a frame to its inference result
+};
+
+/**
+ * Searches the batch size, infer requests, input queue size and CPU streams
+ * for the best throughput. Starting from the given configuration, it tries
+ * the candidates of one parameter at a time while holding the others at the
+ * best values found so far, and repeats until a pass brings no improvement.
+ * Every measured configuration is kept for the Pareto front of throughput
+ * and latency.
+ */
+class AutoTuner {
+public:
+    // Measures a configuration, returns false if the pipeline could not run with it
+    using TrialFunc = std::function<bool(const TuneConfig&, TuneResult&)>;
+
+    /**
+     * @param tuneStreams - whether CPU streams are searched; they mean nothing on other devices
+     */
+    AutoTuner(const TuneConfig& start, bool tuneStreams, TrialFunc trial);
+
+    void run();
+
+    // Configurations no other one beats in both throughput and latency, fastest first
+    std::vector<TuneResult> paretoFront() const;
+
+    // Writes the configurations as JSON with their flags
+    static void writeReport(const std::string& path, const std::vector<TuneResult>& results);
+
+private:
+    TuneConfig start;
+    bool tuneStreams;
+    TrialFunc trial;
+    std::vector<TuneResult> results;
+    std::vector<TuneConfig> failed;
+
+    // Measures a configuration once, returns the result or nullptr if it failed
+    const TuneResult* measure(const TuneConfig& config);
+};
+
+/**
+ * Runs this program again with extra arguments, which override the earlier
+ * ones, and reads the throughput and latency it wrote to reportPath.
+ */
+bool runTrialProcess(const std::vector<std::string>& args, const std::string& reportPath, TuneResult& result);
+
+// Written by the trial process at exit
+void writeTrialReport(const std::string& path, float fps, std::vector<float>& latencies);
@@ -0,0 +1,34 @@
+#include "blocking_ring.hpp"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+// std::atomic<std::uint32_t> is used as the futex word
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "Unexpected atomic layout");
+
+void waitOnAddress(const std::atomic<std::uint32_t>& addr, std::uint32_t expected) {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<const std::uint32_t*>(&addr), FUTEX_WAIT_PRIVATE, expected,
+            nullptr, nullptr, 0);
+#else
+    if (addr.load() == expected) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+#endif
+}
+
+void wakeAddress(const std::atomic<std::uint32_t>& addr, int count) {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<const std::uint32_t*>(&addr), FUTEX_WAKE_PRIVATE, count,
+            nullptr, nullptr, 0);
+#else
+    (void)addr;
+    (void)count;
+#endif
+}
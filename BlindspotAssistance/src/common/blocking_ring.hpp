@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include "mpmc_ring.hpp"
+
+/**
+ * Blocks the calling thread while *addr == expected or until it is woken by
+ * wakeAddress. May return spuriously.
+ */
+void waitOnAddress(const std::atomic<std::uint32_t>& addr, std::uint32_t expected);
+
+/**
+ * Wakes up to count threads blocked in waitOnAddress on addr.
+ */
+void wakeAddress(const std::atomic<std::uint32_t>& addr, int count);
+
+/**
+ * MpmcRing with blocking pop. Consumers spin briefly and then park on a futex
+ * until a producer publishes an element or the wait is cancelled; producers
+ * only make a syscall when somebody is actually parked.
+ */
+template<typename T>
+class BlockingRing final {
+    static constexpr int SpinCount = 64;
+
+    MpmcRing<T> ring;
+    std::atomic<std::uint32_t> epoch = {0};
+    std::atomic<std::uint32_t> waiters = {0};
+
+public:
+    explicit BlockingRing(std::size_t minCapacity): ring(minCapacity) {}
+
+    // Fails only when the ring is full
+    template<typename U>
+    bool tryPush(U&& value) {
+        if (!ring.tryPush(std::forward<U>(value))) {
+            return false;
+        }
+        epoch.fetch_add(1);
+        if (waiters.load() > 0) {
+            wakeAddress(epoch, 1);
+        }
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        return ring.tryPop(value);
+    }
+
+    /**
+     * Waits for an element. Returns false without one once cancelled()
+     * returns true and the ring is empty; whoever makes it true must call
+     * notifyAll() afterwards.
+     */
+    template<typename Cancelled>
+    bool pop(T& value, Cancelled&& cancelled) {
+        for (int i = 0; i < SpinCount; ++i) {
+            if (ring.tryPop(value)) {
+                return true;
+            }
+        }
+        while (true) {
+            if (ring.tryPop(value)) {
+                return true;
+            }
+            if (cancelled()) {
+                return false;
+            }
+            // The epoch is read before the final check, so a push that lands
+            // after the check changes it and the wait returns immediately
+            waiters.fetch_add(1);
+            auto e = epoch.load();
+            if (ring.empty() && !cancelled()) {
+                waitOnAddress(epoch, e);
+            }
+            waiters.fetch_sub(1);
+        }
+    }
+
+    // Wakes every parked consumer so it can re-check its cancel flag
+    void notifyAll() {
+        epoch.fetch_add(1);
+        wakeAddress(epoch, std::numeric_limits<int>::max());
+    }
+
+    std::size_t size() const {
+        return ring.size();
+    }
+
+    bool empty() const {
+        return ring.empty();
+    }
+};
@@ -390,6 +390,7 @@ struct Decoder::HwContext {
                 assert(nullptr != desc.available_surfaces);
                 CHECK_VA(vaSyncSurface(va_display.get(), desc.convert_surface));
                 cv::Mat mat;
+                mat.allocator = &getFramePool();
                 VAImage image = {};
                 CHECK_VA(vaDeriveImage(va_display.get(), desc.convert_surface, &image));
 
@@ -879,7 +880,8 @@ struct Decoder::HwContext {
 #endif
 
 Decoder::Decoder(const Settings& s):
-    settings(s) {
+    settings(s),
+    perf_timer_sw(s.collect_stats ? PerfTimer::DefaultIterationsCount : 0) {
     if (Mode::Hw == settings.mode) {
 #ifdef USE_LIBVA
         hw_context.reset(new HwContext(settings));
@@ -890,6 +892,51 @@ Decoder::Decoder(const Settings& s):
 }
 
 Decoder::~Decoder() {
+    // Pending decode jobs refer to this object
+    std::unique_lock<std::mutex> lock(pending_mutex);
+    pending_changed.wait(lock, [this]() { return pending.empty() && !delivering; });
+}
+
+Decoder::PendingFrame* Decoder::reserve_slot(callback_t callback) {
+    std::unique_lock<std::mutex> lock(pending_mutex);
+    pending_changed.wait(lock, [this]() {
+        return pending.size() < std::max(1u, settings.num_buffers);
+    });
+    pending.emplace_back();
+    pending.back().callback = std::move(callback);
+    return &pending.back();
+}
+
+void Decoder::complete_slot(PendingFrame* slot, cv::Mat&& img) {
+    std::vector<PendingFrame> ready;
+    std::unique_lock<std::mutex> lock(pending_mutex);
+    slot->img = std::move(img);
+    slot->done = true;
+    // One thread at a time delivers the finished prefix, so deliveries of one stream never
+    // overlap or reorder; a frame finished meanwhile is picked up by its next round
+    if (delivering) {
+        return;
+    }
+    delivering = true;
+    while (true) {
+        while (!pending.empty() && pending.front().done) {
+            ready.push_back(std::move(pending.front()));
+            pending.pop_front();
+        }
+        if (ready.empty()) {
+            break;
+        }
+        pending_changed.notify_all();
+        // Callbacks take the stream's own locks, so they run without pending_mutex
+        lock.unlock();
+        for (auto& frame : ready) {
+            frame.callback(std::move(frame.img));
+        }
+        ready.clear();
+        lock.lock();
+    }
+    delivering = false;
+    pending_changed.notify_all();
 }
 
 Decoder::Stats Decoder::getStats() const {
@@ -898,7 +945,8 @@ Decoder::Stats Decoder::getStats() const {
         return {hw_context->getLatency()};
     }
 #endif
-    return {};
+    std::lock_guard<std::mutex> lock(sw_stats_mutex);
+    return {perf_timer_sw.getValue()};
 }
 
 #ifdef USE_LIBVA
@@ -5,17 +5,34 @@
 #pragma once
 
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <type_traits>
 #include <utility>
 
 #include <opencv2/opencv.hpp>
 
+#include "frame_pool.hpp"
+#include "perf_timer.hpp"
+
 #ifdef USE_TBB
 #include "threading.hpp"
+#else
+#include "worker_pool.hpp"
 #endif
 
+/**
+ * Decoding context of a single stream. Decoders share no state, so every
+ * source owns one and streams are decoded in parallel.
+ * In Async mode frames of a stream are decoded concurrently on the TBB arena
+ * or, without TBB, on the decode worker pool. Callbacks are still invoked in
+ * submission order, and decode() blocks while num_buffers frames of the
+ * stream are in flight.
+ */
 class Decoder final {
 public:
     enum class Mode {
@@ -26,6 +43,8 @@ public:
 
     struct Settings {
         Mode mode = Mode::Immediate;
+        // Smallest size frames are needed at. Software decoding scales by 1/2, 1/4 or 1/8
+        // in the DCT domain as long as the result still covers it; 0 keeps the full size.
         unsigned output_width = 0;
         unsigned output_height = 0;
         unsigned num_buffers = 1;
@@ -35,6 +54,7 @@ public:
     explicit Decoder(const Settings& s);
     Decoder(const Decoder&) = delete;
     Decoder& operator =(const Decoder&) = delete;
+    // Waits for the frames still being decoded
     ~Decoder();
 
     struct Stats {
@@ -53,24 +73,17 @@ public:
 
         auto mode = settings.mode;
         if (Mode::Immediate == mode) {
-            auto img = cv::imdecode(
-            {static_cast<const char*>(data),
-             static_cast<int>(size)},
-                           cv::IMREAD_COLOR);
-            callback(std::move(img));
+            callback(decode_timed(data, size, width, height));
         } else if (Mode::Async == mode) {
-#ifdef USE_TBB
-            auto decode = [data, size, c = std::move(callback), this]() mutable {
-                auto img = cv::imdecode(
-                {static_cast<const char*>(data),
-                 static_cast<int>(size)},
-                            cv::IMREAD_COLOR);
-                c(std::move(img));
+            auto slot = reserve_slot(make_copyable(std::forward<F>(callback)));
+            auto decode = [data, size, width, height, slot, this]() {
+                complete_slot(slot, decode_timed(data, size, width, height));
             };
+#ifdef USE_TBB
             auto& arena = get_tbb_arena();
             arena.enqueue(std::move(decode));
 #else
-            throw std::logic_error("Async decoding is not supported");
+            getDecodePool().submit(std::move(decode));
 #endif
         } else if (Mode::Hw == mode) {
 #ifdef USE_LIBVA
@@ -90,8 +103,27 @@ public:
 
 private:
     const Settings settings;
-#ifdef USE_LIBVA
-    struct HwContext;
+
+    mutable std::mutex sw_stats_mutex;  // async decodes of one stream may finish concurrently
+    PerfTimer perf_timer_sw;
+
+    using callback_t = std::function<void(cv::Mat&&)>;
+
+    // Async frames in submission order; references stay valid while in the deque
+    struct PendingFrame {
+        callback_t callback;
+        cv::Mat img;
+        bool done = false;
+    };
+    std::mutex pending_mutex;
+    std::condition_variable pending_changed;
+    std::deque<PendingFrame> pending;
+    bool delivering = false;  // a thread is running the callbacks of finished frames
+
+    PendingFrame* reserve_slot(callback_t callback);
+    void complete_slot(PendingFrame* slot, cv::Mat&& img);
+
+    // std::function needs copyable targets, callbacks may own move-only frames
     template<typename T>
     struct MoveHack {
         union {
@@ -119,8 +151,47 @@ private:
         return MoveHack<typename std::remove_reference<T>::type>{std::move(val)};
     }
 
-    using callback_t = std::function<void(cv::Mat&&)>;
+    cv::Mat decode_timed(const void* data, size_t size, unsigned width, unsigned height) {
+        if (!perf_timer_sw.enabled()) {
+            return decode_sw(data, size, width, height);
+        }
+        auto start_time = std::chrono::high_resolution_clock::now();
+        auto img = decode_sw(data, size, width, height);
+        auto duration = std::chrono::high_resolution_clock::now() - start_time;
+        std::lock_guard<std::mutex> lock(sw_stats_mutex);
+        perf_timer_sw.addValue(duration);
+        return img;
+    }
 
+    cv::Mat decode_sw(const void* data, size_t size, unsigned width, unsigned height) const {
+        cv::Mat img;
+        img.allocator = &getFramePool();
+        cv::imdecode({static_cast<const char*>(data),
+                      static_cast<int>(size)},
+                     imread_flags(width, height), &img);
+        return img;
+    }
+
+    // IMREAD_REDUCED_COLOR_* for the strongest scaling that keeps the output size covered
+    int imread_flags(unsigned width, unsigned height) const {
+        const unsigned out_width = settings.output_width;
+        const unsigned out_height = settings.output_height;
+        if (0 == out_width || 0 == out_height) {
+            return cv::IMREAD_COLOR;
+        }
+        if (width / 8 >= out_width && height / 8 >= out_height) {
+            return cv::IMREAD_REDUCED_COLOR_8;
+        }
+        if (width / 4 >= out_width && height / 4 >= out_height) {
+            return cv::IMREAD_REDUCED_COLOR_4;
+        }
+        if (width / 2 >= out_width && height / 2 >= out_height) {
+            return cv::IMREAD_REDUCED_COLOR_2;
+        }
+        return cv::IMREAD_COLOR;
+    }
+#ifdef USE_LIBVA
+    struct HwContext;
     std::unique_ptr<HwContext> hw_context;
 
     void decode_hw(const void* data, size_t size, unsigned width,
@@ -0,0 +1,120 @@
+#include "frame_pool.hpp"
+
+#include <iterator>
+#include <new>
+
+FramePool::FramePool(std::size_t maxFreeBuffers_):
+    maxFreeBuffers(maxFreeBuffers_) {
+    freeBuffers.reserve(maxFreeBuffers);
+}
+
+FramePool::~FramePool() {
+    for (auto& b : freeBuffers) {
+        cv::fastFree(b.data);
+        delete b.u;
+    }
+}
+
+cv::UMatData* FramePool::allocate(int dims, const int* sizes, int type, void* data0, std::size_t* step,
+                                  cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+    std::size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data0 && step[i] != CV_AUTOSTEP) {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    if (data0) {
+        // Wraps user memory, nothing to recycle
+        ++allocations;
+        auto u = new cv::UMatData(this);
+        u->data = u->origdata = static_cast<uchar*>(data0);
+        u->size = total;
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+        return u;
+    }
+
+    ++buffers;
+    FreeBuffer buffer = {nullptr, nullptr, 0};
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // The most recently released buffer is the most likely one to be in cache
+        for (auto it = freeBuffers.rbegin(); it != freeBuffers.rend(); ++it) {
+            if (it->size == total) {
+                buffer = *it;
+                freeBuffers.erase(std::next(it).base());
+                break;
+            }
+        }
+    }
+
+    cv::UMatData* u = buffer.u;
+    if (nullptr != u) {
+        u->~UMatData();
+        new (u) cv::UMatData(this);
+    } else {
+        ++allocations;
+        u = new cv::UMatData(this);
+    }
+    if (nullptr == buffer.data) {
+        ++allocations;
+        buffer.data = static_cast<uchar*>(cv::fastMalloc(total));
+    }
+    u->data = u->origdata = buffer.data;
+    u->size = total;
+    return u;
+}
+
+bool FramePool::allocate(cv::UMatData* u, cv::AccessFlag /*accessFlags*/, cv::UMatUsageFlags /*usageFlags*/) const {
+    return nullptr != u;
+}
+
+void FramePool::deallocate(cv::UMatData* u) const {
+    if (nullptr == u) {
+        return;
+    }
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    if (u->flags & cv::UMatData::USER_ALLOCATED) {
+        delete u;
+        return;
+    }
+
+    FreeBuffer buffer = {u, u->origdata, u->size};
+    FreeBuffer evicted = {nullptr, nullptr, 0};
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (0 == maxFreeBuffers) {
+            evicted = buffer;
+        } else {
+            if (freeBuffers.size() == maxFreeBuffers) {
+                evicted = freeBuffers.front();
+                freeBuffers.erase(freeBuffers.begin());
+            }
+            freeBuffers.push_back(buffer);
+        }
+    }
+    if (nullptr != evicted.u) {
+        cv::fastFree(evicted.data);
+        delete evicted.u;
+    }
+}
+
+FramePool::Stats FramePool::getStats() const {
+    Stats ret;
+    ret.buffers = buffers;
+    ret.allocations = allocations;
+    return ret;
+}
+
+FramePool& getFramePool() {
+    // Intentionally leaked: frames may still be released during static destruction
+    static FramePool* pool = new FramePool(64);
+    return *pool;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * cv::MatAllocator that keeps the buffers released by cv::Mat and hands them
+ * out again for the next image of the same size instead of returning them to
+ * the heap. Video sources and decoders set it as the allocator of the Mat they
+ * write a frame into, so once the pipeline is warmed up every captured frame
+ * reuses the buffer of a frame that has already left the pipeline, and frames
+ * are shared by reference from capture through preprocessing to display.
+ */
+class FramePool final : public cv::MatAllocator {
+public:
+    explicit FramePool(std::size_t maxFreeBuffers);
+    FramePool(const FramePool&) = delete;
+    FramePool& operator =(const FramePool&) = delete;
+    ~FramePool();
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, std::size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+    struct Stats {
+        std::uint64_t buffers = 0;      // buffers handed out
+        std::uint64_t allocations = 0;  // heap allocations made to serve them
+    };
+
+    Stats getStats() const;
+
+private:
+    struct FreeBuffer {
+        cv::UMatData* u;
+        uchar* data;
+        std::size_t size;
+    };
+
+    const std::size_t maxFreeBuffers;
+    mutable std::mutex mutex;
+    mutable std::vector<FreeBuffer> freeBuffers;
+    mutable std::atomic<std::uint64_t> buffers = {0};
+    mutable std::atomic<std::uint64_t> allocations = {0};
+};
+
+/**
+ * Pool shared by all video sources and decoders. It is never destroyed, so
+ * frames may safely outlive the objects that produced them.
+ */
+FramePool& getFramePool();
@@ -0,0 +1,98 @@
+#include "frame_scheduler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+std::size_t channelCount(const std::vector<std::vector<std::size_t>>& channelsPerProducer) {
+    std::size_t count = 0;
+    for (auto& producerChannels : channelsPerProducer) {
+        for (auto channel : producerChannels) {
+            count = std::max(count, channel + 1);
+        }
+    }
+    return count;
+}
+}  // namespace
+
+constexpr std::size_t FrameScheduler::None;
+
+FrameScheduler::FrameScheduler(std::vector<std::vector<std::size_t>> channelsPerProducer, ReadyFunc readyFunc):
+    channels(std::move(channelsPerProducer)), ready(std::move(readyFunc)),
+    priorities(channelCount(channels)), minIntervals(priorities.size()), lastServed(priorities.size()),
+    cursor(channels.size(), 0) {
+    if (nullptr == ready) {
+        throw std::logic_error("Frame scheduler needs a readiness query");
+    }
+    for (auto& priority : priorities) {
+        priority = 1.0f;
+    }
+    for (auto& interval : minIntervals) {
+        interval = 0;
+    }
+}
+
+void FrameScheduler::setPriority(std::size_t channel, float priority) {
+    if (channel >= priorities.size() || !(priority > 0.0f)) {
+        throw std::logic_error("Invalid frame scheduler priority");
+    }
+    priorities[channel] = priority;
+}
+
+void FrameScheduler::setMaxRate(std::size_t channel, float readsPerSecond) {
+    if (channel >= minIntervals.size() || readsPerSecond < 0.0f) {
+        throw std::logic_error("Invalid frame scheduler rate");
+    }
+    Clock::duration interval = Clock::duration::zero();
+    if (readsPerSecond > 0.0f) {
+        interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(1.0f / readsPerSecond));
+    }
+    minIntervals[channel] = interval.count();
+}
+
+std::size_t FrameScheduler::next(std::size_t producer, Clock::time_point now) {
+    auto& producerChannels = channels[producer];
+    const std::size_t count = producerChannels.size();
+    std::size_t best = None;
+    float bestScore = -1.0f;
+    for (std::size_t i = 0; i < count; ++i) {
+        // Start after the previous pick so equal scores are served in turn
+        std::size_t pos = (cursor[producer] + i) % count;
+        std::size_t channel = producerChannels[pos];
+        auto since = ready(channel);
+        if (Clock::time_point::max() == since) {
+            continue;
+        }
+        const Clock::duration minInterval(minIntervals[channel].load());
+        if (minInterval > Clock::duration::zero() && now < lastServed[channel] + minInterval) {
+            continue;
+        }
+        since = std::max(since, lastServed[channel]);
+        auto waited = std::chrono::duration<float, std::milli>(now > since ? now - since : Clock::duration::zero());
+        // A channel served this very moment still beats nothing, and priority decides between fresh ones
+        float score = (waited.count() + 1.0f) * priorities[channel];
+        if (score > bestScore) {
+            bestScore = score;
+            best = pos;
+        }
+    }
+    if (None == best) {
+        return None;
+    }
+    cursor[producer] = (best + 1) % count;
+    std::size_t channel = producerChannels[best];
+    lastServed[channel] = now;
+    return channel;
+}
+
+FrameScheduler::Clock::time_point FrameScheduler::nextDue(std::size_t producer) const {
+    auto due = Clock::time_point::max();
+    for (auto channel : channels[producer]) {
+        const Clock::duration minInterval(minIntervals[channel].load());
+        if (minInterval > Clock::duration::zero() && Clock::time_point::max() != ready(channel)) {
+            due = std::min(due, lastServed[channel] + minInterval);
+        }
+    }
+    return due;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <vector>
+
+/**
+ * Chooses the channel a batch producer reads next. Only channels that can be
+ * read without blocking are considered. Among them the one whose frame has
+ * waited longest, scaled by the channel priority, wins, so a stalled camera
+ * never holds back the others and no ready camera starves. A channel's wait
+ * counts from when its frame became available or from when the channel was
+ * last served, whichever is later. A channel may also be limited to a number
+ * of reads per second, and is then passed over until its next read is due.
+ * next() may be called concurrently for different producers; every channel
+ * belongs to exactly one producer.
+ */
+class FrameScheduler final {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Time since which the channel can be read without blocking; time_point::max() while it would block
+    using ReadyFunc = std::function<Clock::time_point(std::size_t)>;
+
+    static constexpr std::size_t None = std::numeric_limits<std::size_t>::max();
+
+    /**
+     * @param channelsPerProducer - channels served by each producer
+     * @param ready - readiness query for a channel
+     */
+    FrameScheduler(std::vector<std::vector<std::size_t>> channelsPerProducer, ReadyFunc ready);
+
+    // Channels default to priority 1; the weight may be changed from any thread
+    void setPriority(std::size_t channel, float priority);
+
+    // Reads per second the channel is limited to, 0 for no limit; may be changed from any thread
+    void setMaxRate(std::size_t channel, float readsPerSecond);
+
+    // Channel that producer should read now, or None if none of its channels is ready
+    std::size_t next(std::size_t producer, Clock::time_point now);
+
+    // When a ready channel of producer that next() passed over for its rate limit is due; max() if none
+    Clock::time_point nextDue(std::size_t producer) const;
+
+private:
+    std::vector<std::vector<std::size_t>> channels;
+    ReadyFunc ready;
+    std::vector<std::atomic<float>> priorities;
+    std::vector<std::atomic<Clock::rep>> minIntervals;  // between reads, 0 without a rate limit
+    std::vector<Clock::time_point> lastServed;  // written only by the owning producer
+    std::vector<std::size_t> cursor;            // round robin start per producer, breaks ties
+};
@@ -4,12 +4,24 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
 #include <memory>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include <samples/ocv_common.hpp>
+
 #include "graph.hpp"
+#include "network_cache.hpp"
+#include "preprocess.hpp"
 #include "threading.hpp"
 
 #ifdef USE_TBB
@@ -17,32 +29,69 @@
 #endif
 
 namespace {
-
-void loadImgToIEGraph(const cv::Mat& img, size_t batch, void* ieBuffer) {
-    const int channels = img.channels();
-    const int height = img.rows;
-    const int width = img.cols;
-
-    float* ieData = reinterpret_cast<float*>(ieBuffer);
-    int bOffset = static_cast<int>(batch) * channels * width * height;
-    for (int c = 0; c < channels; c++) {
-        int cOffset = c * width * height;
-        for (int w = 0; w < width; w++) {
-            for (int h = 0; h < height; h++) {
-                ieData[bOffset + cOffset + h * width + w] =
-                        static_cast<float>(img.at<cv::Vec3b>(h, w)[c]);
-            }
+// Warm-up stops once a round of all requests takes within this share of the previous round
+const float WarmUpTolerance = 0.1f;
+const std::size_t WarmUpMaxRounds = 10;
+
+// Distinct cores in /proc/cpuinfo; SMT siblings share one. Falls back to the hardware threads.
+std::size_t physicalCoreCount() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::set<std::pair<std::string, std::string>> cores;
+    std::string package;
+    for (std::string line; std::getline(cpuinfo, line);) {
+        auto colon = line.find(':');
+        if (std::string::npos == colon) {
+            continue;
+        }
+        auto value = colon + 1 < line.size() ? line.substr(colon + 1) : std::string();
+        if (0 == line.compare(0, 11, "physical id")) {
+            package = value;
+        } else if (0 == line.compare(0, 7, "core id")) {
+            cores.emplace(package, value);
         }
     }
+    return !cores.empty() ? cores.size() : std::max(1u, std::thread::hardware_concurrency());
 }
-
 }  // namespace
 
-void IEGraph::initNetwork(const std::string& deviceName) {
-    auto cnnNetwork = ie.ReadNetwork(modelPath);
+std::size_t IEGraph::autoCpuStreams(std::size_t maxRequests, std::size_t cpuThreads) {
+    // A stream infers one request at a time, so streams beyond the number of requests idle,
+    // and each stream keeps at least two cores so a single request is not slowed down;
+    // SMT siblings add little to inference, so they are not counted
+    const std::size_t cores = 0 != cpuThreads ? cpuThreads : physicalCoreCount();
+    return std::max<std::size_t>(1, std::min(maxRequests, cores / 2));
+}
 
+void IEGraph::initNetwork(const std::string& deviceName) {
+    // Startup time per stage, logged once the network is ready
+    using clock = std::chrono::steady_clock;
+    std::vector<std::pair<const char*, float>> stages;
+    auto stageStart = clock::now();
+    auto endStage = [&](const char* name) {
+        auto now = clock::now();
+        stages.emplace_back(name, std::chrono::duration<float, std::milli>(now - stageStart).count());
+        stageStart = now;
+    };
+
+    std::map<std::string, std::string> cpuConfig;
     if (deviceName.find("CPU") != std::string::npos) {
-        ie.SetConfig({{InferenceEngine::PluginConfigParams::KEY_CPU_BIND_THREAD, "NO"}}, "CPU");
+        std::string streams = "default";
+        if ("auto" == cpuStreams) {
+            streams = std::to_string(autoCpuStreams(maxRequests, cpuThreads));
+        } else if (!cpuStreams.empty()) {
+            streams = cpuStreams;
+        }
+        if (!cpuStreams.empty()) {
+            cpuConfig[InferenceEngine::PluginConfigParams::KEY_CPU_THROUGHPUT_STREAMS] = streams;
+        }
+        if (0 != cpuThreads) {
+            cpuConfig[InferenceEngine::PluginConfigParams::KEY_CPU_THREADS_NUM] = std::to_string(cpuThreads);
+        }
+        cpuConfig[InferenceEngine::PluginConfigParams::KEY_CPU_BIND_THREAD] = cpuBindThread;
+        ie.SetConfig(cpuConfig, "CPU");
+        slog::info << "CPU execution: " << streams << " streams, "
+                   << (0 != cpuThreads ? std::to_string(cpuThreads) : std::string("default")) << " threads, binding "
+                   << cpuBindThread << slog::endl;
     }
     if (!cpuExtensionPath.empty()) {
         auto extension_ptr = InferenceEngine::make_so_pointer<InferenceEngine::IExtension>(cpuExtensionPath);
@@ -56,43 +105,187 @@ void IEGraph::initNetwork(const std::string& deviceName) {
         ie.SetConfig({ { InferenceEngine::PluginConfigParams::KEY_PERF_COUNT, InferenceEngine::PluginConfigParams::YES } });
     }
 
-    // Set batch size
-    if (batchSize > 1) {
-        auto inShapes = cnnNetwork.getInputShapes();
-        for (auto& pair : inShapes) {
-            auto& dims = pair.second;
-            if (!dims.empty()) {
-                dims[0] = batchSize;
-            }
-        }
-        cnnNetwork.reshape(inShapes);
+    std::map<std::string, std::string> loadConfig;
+    if (dynamicBatch) {
+        loadConfig[InferenceEngine::PluginConfigParams::KEY_DYN_BATCH_ENABLED] = InferenceEngine::PluginConfigParams::YES;
     }
 
-    InferenceEngine::ExecutableNetwork network;
-    network = ie.LoadNetwork(cnnNetwork, deviceName);
+    // The resize set up on the network inputs is not part of an exported network, so it is always compiled
+    std::unique_ptr<CompiledNetworkCache> cache;
+    if (!compiledCacheDir.empty() && !iePreprocessing) {
+        // Everything that changes the compiled network is part of the key
+        auto keyConfig = loadConfig;
+        keyConfig["PERF_COUNT"] = printPerfReport ? "YES" : "NO";
+        keyConfig["CPU_EXTENSION"] = cpuExtensionPath;
+        keyConfig["CLDNN_CONFIG"] = cldnnConfigPath;
+        keyConfig.insert(cpuConfig.begin(), cpuConfig.end());
+        cache.reset(new CompiledNetworkCache(compiledCacheDir, modelPath, deviceName, batchSize, keyConfig));
+        endStage("cache key");
+    }
 
-    InferenceEngine::InputsDataMap inputInfo(cnnNetwork.getInputsInfo());
-    if (inputInfo.size() != 1) {
-        throw std::logic_error("Face Detection network should have only one input");
+    InferenceEngine::ExecutableNetwork network;
+    InferenceEngine::CNNNetwork cnnNetwork;
+    bool imported = false;
+    if (cache && cache->exists()) {
+        try {
+            network = ie.ImportNetwork(cache->path(), deviceName, loadConfig);
+            imported = true;
+            endStage("import");
+        } catch (const std::exception& e) {
+            slog::warn << "Cannot import compiled network " << cache->path() << ": " << e.what() << slog::endl;
+            cache->discard();
+            endStage("failed import");
+        }
     }
-    inputDataBlobName = inputInfo.begin()->first;
 
-    InferenceEngine::OutputsDataMap outputInfo(cnnNetwork.getOutputsInfo());
-    outputDataBlobNames.reserve(outputInfo.size());
-    for (const auto& i : outputInfo) {
-        outputDataBlobNames.push_back(i.first);
+    if (imported) {
+        auto inputs = network.GetInputsInfo();
+        if (inputs.size() != 1) {
+            throw std::logic_error("Face Detection network should have only one input");
+        }
+        inputDataBlobName = inputs.begin()->first;
+        inputDims = inputs.begin()->second->getTensorDesc().getDims();
+        if (inputReady != nullptr) {
+            inputReady(inputDims);
+        }
+        auto outputs = network.GetOutputsInfo();
+        outputDataBlobNames.reserve(outputs.size());
+        for (const auto& i : outputs) {
+            outputDataBlobNames.push_back(i.first);
+        }
+        if (postLoad != nullptr) {
+            cnnNetwork = ie.ReadNetwork(modelPath);
+            endStage("read");
+        }
+    } else {
+        cnnNetwork = ie.ReadNetwork(modelPath);
+        endStage("read");
+
+        // Set batch size
+        if (batchSize > 1) {
+            auto inShapes = cnnNetwork.getInputShapes();
+            for (auto& pair : inShapes) {
+                auto& dims = pair.second;
+                if (!dims.empty()) {
+                    dims[0] = batchSize;
+                }
+            }
+            cnnNetwork.reshape(inShapes);
+            endStage("reshape");
+        }
+
+        InferenceEngine::InputsDataMap inputInfo(cnnNetwork.getInputsInfo());
+        if (inputInfo.size() != 1) {
+            throw std::logic_error("Face Detection network should have only one input");
+        }
+        inputDataBlobName = inputInfo.begin()->first;
+        inputDims = inputInfo.begin()->second->getTensorDesc().getDims();
+        if (inputReady != nullptr) {
+            inputReady(inputDims);
+        }
+        if (iePreprocessing) {
+            auto& input = inputInfo.begin()->second;
+            input->setPrecision(InferenceEngine::Precision::U8);
+            input->setLayout(InferenceEngine::Layout::NHWC);
+            input->getPreProcess().setResizeAlgorithm(InferenceEngine::ResizeAlgorithm::RESIZE_BILINEAR);
+        }
+
+        network = ie.LoadNetwork(cnnNetwork, deviceName, loadConfig);
+        endStage("load");
+
+        InferenceEngine::OutputsDataMap outputInfo(cnnNetwork.getOutputsInfo());
+        outputDataBlobNames.reserve(outputInfo.size());
+        for (const auto& i : outputInfo) {
+            outputDataBlobNames.push_back(i.first);
+        }
+
+        if (cache) {
+            // Not every plugin can export; the network is then compiled on every start
+            try {
+                cache->store([&network](const std::string& path) { network.Export(path); });
+                cache->pruneStale();
+                endStage("export");
+            } catch (const std::exception& e) {
+                slog::warn << "Cannot export compiled network to " << cache->path() << ": " << e.what() << slog::endl;
+            }
+        }
     }
 
     for (size_t i = 0; i < maxRequests; ++i) {
-        auto req = network.CreateInferRequestPtr();
-        availableRequests.push(req);
+        requests.push_back(network.CreateInferRequestPtr());
+        availableRequests[i % producers]->tryPush(i);
     }
+    endStage("requests");
 
     if (postLoad != nullptr)
         postLoad(outputDataBlobNames, cnnNetwork);
 
-    availableRequests.front()->StartAsync();
-    availableRequests.front()->Wait(InferenceEngine::IInferRequest::WaitMode::RESULT_READY);
+    const std::size_t warmUpRounds = warmUp();
+    endStage("warm-up");
+
+    if (completionCallbacks) {
+        for (size_t i = 0; i < requests.size(); ++i) {
+            requests[i]->SetCompletionCallback([this, i]() {
+                batchResults.tryPush(std::move(requestSlots[i]));
+            });
+        }
+    }
+
+    float total = 0.0f;
+    std::ostringstream breakdown;
+    breakdown << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < stages.size(); ++i) {
+        breakdown << (0 == i ? "" : ", ") << stages[i].first << " " << stages[i].second << "ms";
+        total += stages[i].second;
+    }
+    slog::info << "Network startup " << std::fixed << std::setprecision(1) << total << "ms ("
+               << (imported ? "compiled network imported" : "network compiled") << "): "
+               << breakdown.str() << slog::endl;
+    slog::info << "Warm-up took " << warmUpRounds << " rounds of " << requests.size() << " requests" << slog::endl;
+}
+
+std::size_t IEGraph::warmUp() {
+    // Plugins allocate lazily on the first inference of each request and batch size,
+    // which would otherwise show up as latency spikes on the first live batches
+    for (auto& req : requests) {
+        auto inputBlob = req->GetBlob(inputDataBlobName);
+        auto buff = inputBlob->buffer();
+        std::memset(static_cast<char*>(buff), 0, inputBlob->byteSize());
+    }
+    auto runRound = [this](std::size_t frames) {
+        auto start = std::chrono::steady_clock::now();
+        for (auto& req : requests) {
+            if (dynamicBatch) {
+                req->SetBatch(static_cast<int>(frames));
+            }
+            req->StartAsync();
+        }
+        for (auto& req : requests) {
+            req->Wait(InferenceEngine::IInferRequest::WaitMode::RESULT_READY);
+        }
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::size_t rounds = 0;
+    if (dynamicBatch) {
+        // Partial batches run with their own size
+        for (std::size_t frames = 1; frames < batchSize; ++frames) {
+            runRound(frames);
+            ++rounds;
+        }
+    }
+    // Full batches until two rounds in a row take about as long
+    float last = runRound(batchSize);
+    ++rounds;
+    for (std::size_t i = 1; i < WarmUpMaxRounds; ++i) {
+        const float current = runRound(batchSize);
+        ++rounds;
+        if (std::abs(current - last) <= WarmUpTolerance * last) {
+            break;
+        }
+        last = current;
+    }
+    return rounds;
 }
 
 void IEGraph::start(GetterFunc getterFunc, PostprocessingFunc postprocessingFunc) {
@@ -101,153 +294,261 @@ void IEGraph::start(GetterFunc getterFunc, PostprocessingFunc postprocessingFunc
     assert(nullptr == getter);
     getter = std::move(getterFunc);
     postprocessing = std::move(postprocessingFunc);
-    getterThread = std::thread([&]() {
-        std::vector<std::shared_ptr<VideoFrame>> vframes;
-        std::vector<cv::Mat> imgsToProc(batchSize);
-        while (!terminate) {
-            vframes.clear();
-            size_t b = 0;
-            while (b != batchSize) {
-                VideoFrame vframe;
-                if (getter(vframe)) {
-                    vframes.push_back(std::make_shared<VideoFrame>(vframe));
-                    ++b;
-                } else {
-                    terminate = true;
-                    break;
+    activeProducers = producers;
+    for (std::size_t i = 0; i < producers; ++i) {
+        producerThreads.emplace_back(&IEGraph::produce, this, i);
+    }
+}
+
+void IEGraph::produce(std::size_t producer) {
+    auto& available = *availableRequests[producer];
+    auto& timerPreprocess = *perfTimersPreprocess[producer];
+    auto& timerQueueDelay = *perfTimersQueueDelay[producer];
+    const bool useDeadline = batchDeadline.count() > 0;
+    std::vector<std::shared_ptr<VideoFrame>> vframes;
+    while (!terminate) {
+        vframes.clear();
+        auto deadline = FrameDeadline::max();
+        FrameDeadline firstFrameTime;
+        while (vframes.size() != batchSize && !terminate) {
+            if (useDeadline && vframes.empty()) {
+                // A camera that has nothing within the budget is skipped instead of stalling the others
+                deadline = std::chrono::steady_clock::now() + batchDeadline;
+            }
+            auto vframe = videoFramePool.acquire();
+            auto status = getter(*vframe, producer, deadline);
+            if (FrameStatus::Ready == status && sourceOrdered) {
+                std::lock_guard<std::mutex> lock(readSeqMutex);
+                if (vframe->sourceIdx >= readSeqs.size()) {
+                    readSeqs.resize(vframe->sourceIdx + 1, 0);
                 }
+                vframe->readSeq = readSeqs[vframe->sourceIdx]++;
             }
-
-            InferenceEngine::InferRequest::Ptr req;
-            {
-                std::unique_lock<std::mutex> lock(mtxAvalableRequests);
-                condVarAvailableRequests.wait(lock, [&]() {
-                    return !availableRequests.empty() || terminate;
-                });
-                if (terminate) {
+            if (FrameStatus::Ready == status && !vframe->infer) {
+                // Handed out right away instead of waiting for the batch being filled
+                char token = 0;
+                if (!trackedTokens.pop(token, [this]() { return terminate.load(); })) {
                     break;
                 }
-                req = std::move(availableRequests.front());
-                availableRequests.pop();
-            }
-
-            auto inputBlob = req->GetBlob(inputDataBlobName);
-            imgsToProc.resize(batchSize);
-            for (size_t i = 0; i < batchSize; i++) {
-                if (imgsToProc[i].empty()) {
-                    auto& dims = inputBlob->getTensorDesc().getDims();
-                    assert(4 == dims.size());
-                    auto height = static_cast<int>(dims[2]);
-                    auto width  = static_cast<int>(dims[3]);
-                    imgsToProc[i] = cv::Mat(height, width, CV_8UC3);
+                BatchRequestDesc tracked;
+                tracked.vfPtrVec.push_back(std::move(vframe));
+                batchResults.tryPush(std::move(tracked));
+            } else if (FrameStatus::Ready == status) {
+                if (vframes.empty()) {
+                    firstFrameTime = std::chrono::steady_clock::now();
+                    if (useDeadline) {
+                        deadline = firstFrameTime + batchDeadline;
+                    }
+                }
+                vframes.push_back(std::move(vframe));
+            } else if (FrameStatus::NotReady == status) {
+                if (!vframes.empty()) {
+                    break;  // the oldest frame is out of budget, start what we have
                 }
+            } else {
+                terminate = true;
+                break;
             }
+        }
+
+        std::size_t requestIdx = 0;
+        if (!available.pop(requestIdx, [this]() { return terminate.load(); }) || terminate) {
+            break;
+        }
+        auto req = requests[requestIdx];
 
-            auto preprocess = [&]() {
-                auto buff = inputBlob->buffer();
-                float* inputPtr = static_cast<float*>(buff);
-                auto loopBody = [&](size_t i) {
-                    cv::resize(vframes[i]->frame,
-                               imgsToProc[i],
-                               imgsToProc[i].size());
-                    loadImgToIEGraph(imgsToProc[i], i, inputPtr);
-                };
+        auto preprocess = [&]() {
+            if (iePreprocessing) {
+                // The plugin resizes and converts the wrapped frame while inferring it
+                req->SetBlob(inputDataBlobName, wrapMat2Blob(vframes[0]->frame));
+                return;
+            }
+            assert(4 == inputDims.size());
+            const cv::Size inputSize(static_cast<int>(inputDims[3]), static_cast<int>(inputDims[2]));
+            const size_t inputImageSize = inputDims[1] * inputDims[2] * inputDims[3];
+            auto inputBlob = req->GetBlob(inputDataBlobName);
+            auto buff = inputBlob->buffer();
+            float* inputPtr = static_cast<float*>(buff);
+            const size_t frames = vframes.size();
+            auto loopBody = [&](size_t i) {
+                resizeToPlanar(vframes[i]->frame, inputSize, inputPtr + i * inputImageSize);
+            };
 #ifdef USE_TBB
-                run_in_arena([&](){
-                    tbb::parallel_for<size_t>(0, batchSize, loopBody);
-                });
+            run_in_arena([&](){
+                tbb::parallel_for<size_t>(0, frames, loopBody);
+            });
 #else
-                for (size_t i = 0; i < batchSize; i++) {
-                    loopBody(i);
-                }
+            for (size_t i = 0; i < frames; i++) {
+                loopBody(i);
+            }
 #endif
-            };
-
-            if (perfTimerInfer.enabled()) {
-                {
-                    ScopedTimer st(perfTimerPreprocess);
-                    preprocess();
-                }
-                auto startTime = std::chrono::high_resolution_clock::now();
-                req->StartAsync();
-                std::unique_lock<std::mutex> lock(mtxBusyRequests);
-                busyBatchRequests.push({std::move(vframes), std::move(req), startTime});
+            if (dynamicBatch) {
+                req->SetBatch(static_cast<int>(frames));
             } else {
-                preprocess();
-                req->StartAsync();
-                std::unique_lock<std::mutex> lock(mtxBusyRequests);
-                busyBatchRequests.push({std::move(vframes), std::move(req),
-                                    std::chrono::high_resolution_clock::time_point()});
+                // Pad a partial batch with its last frame; postprocessing ignores the extra slots
+                for (size_t i = frames; i < batchSize; i++) {
+                    std::copy_n(inputPtr + (frames - 1) * inputImageSize, inputImageSize, inputPtr + i * inputImageSize);
+                }
             }
-            condVarBusyRequests.notify_one();
+        };
+
+        if (timerPreprocess.enabled()) {
+            ScopedTimer st(timerPreprocess);
+            preprocess();
+        } else {
+            preprocess();
+        }
+
+        BatchRequestDesc desc;
+        desc.vfPtrVec = std::move(vframes);
+        desc.req = std::move(req);
+        desc.requestIdx = requestIdx;
+        if (perfTimerInfer.enabled()) {
+            desc.startTime = std::chrono::high_resolution_clock::now();
+        }
+        if (timerQueueDelay.enabled()) {
+            timerQueueDelay.addValue(std::chrono::steady_clock::now() - firstFrameTime);
+        }
+        ++batchesSubmitted;
+        framesSubmitted += desc.vfPtrVec.size();
+        ++inFlight;
+        if (completionCallbacks) {
+            // The slot is published to the main thread by the completion callback
+            auto& slot = requestSlots[requestIdx];
+            slot = std::move(desc);
+            slot.req->StartAsync();
+        } else {
+            desc.req->StartAsync();
+            batchResults.tryPush(std::move(desc));
         }
-        condVarBusyRequests.notify_one(); // notify that there will be no new InferRequests
-    });
+    }
+    if (0 == --activeProducers) {
+        // notify that there will be no new InferRequests
+        batchResults.notifyAll();
+    }
 }
 
 IEGraph::IEGraph(const InitParams& p):
-    perfTimerPreprocess(p.collectStats ? PerfTimer::DefaultIterationsCount : 0),
     perfTimerInfer(p.collectStats ? PerfTimer::DefaultIterationsCount : 0),
     confidenceThreshold(0.5f), batchSize(p.batchSize),
-    modelPath(p.modelPath),
+    batchDeadline(p.batchDeadline), dynamicBatch(p.dynamicBatch),
+    modelPath(p.modelPath), compiledCacheDir(p.compiledCacheDir),
     cpuExtensionPath(p.cpuExtPath), cldnnConfigPath(p.cldnnConfigPath),
+    cpuStreams(p.cpuStreams), cpuThreads(p.cpuThreads), cpuBindThread(p.cpuBindThread),
+    iePreprocessing(p.iePreprocessing),
     printPerfReport(p.reportPerf), deviceName(p.deviceName),
-    maxRequests(p.maxRequests) {
+    batchResults(p.maxRequests * (1 + p.batchSize)), trackedTokens(p.maxRequests * p.batchSize),
+    completionCallbacks(p.completionCallbacks), orderedResults(p.orderedResults),
+    sourceOrdered(p.orderedResults || p.trackedFrames),
+    requestSlots(p.maxRequests),
+    maxRequests(p.maxRequests),
+    producers(p.producers),
+    // Frames are held by in-flight requests, tracked frames on their way to the main thread,
+    // the display queue and the batch being rendered
+    videoFramePool((2 * p.maxRequests + 2) * p.batchSize * 2, [](VideoFrame& vf) {
+        vf.frame.release();
+        vf.sourceIdx = 0;
+        vf.detections = Detections();
+        vf.infer = true;
+    }) {
     assert(p.maxRequests > 0);
+    if (0 == producers || producers > maxRequests) {
+        throw std::logic_error("Number of producers must be between 1 and the number of infer requests");
+    }
+    for (std::size_t i = 0; i < producers; ++i) {
+        availableRequests.emplace_back(new BlockingRing<std::size_t>(maxRequests));
+        perfTimersPreprocess.emplace_back(new PerfTimer(p.collectStats ? PerfTimer::DefaultIterationsCount : 0));
+        perfTimersQueueDelay.emplace_back(new PerfTimer(p.collectStats ? PerfTimer::DefaultIterationsCount : 0));
+    }
+    if (iePreprocessing && batchSize != 1) {
+        throw std::logic_error("Inference Engine preprocessing supports only batch size 1");
+    }
+    if (orderedResults && !completionCallbacks) {
+        throw std::logic_error("Ordered results are only meaningful with completion callbacks");
+    }
+    for (std::size_t i = 0; i < maxRequests * batchSize; ++i) {
+        trackedTokens.tryPush('\0');
+    }
 
     postLoad = p.postLoadFunc;
+    inputReady = p.inputReadyFunc;
     initNetwork(p.deviceName);
+    if (iePreprocessing) {
+        slog::info << "Preprocessing: U8 NHWC input resized by the Inference Engine" << slog::endl;
+    } else {
+        slog::info << "Preprocessing kernel: " << hwcToPlanarIsa() << slog::endl;
+    }
 }
 
 bool IEGraph::isRunning() {
-    std::lock_guard<std::mutex> lock(mtxBusyRequests);
-    return !terminate || !busyBatchRequests.empty();
+    return !terminate || activeProducers > 0 || inFlight > 0;
 }
 
 InferenceEngine::SizeVector IEGraph::getInputDims() const {
-    assert(!availableRequests.empty());
-    auto inputBlob = availableRequests.front()->GetBlob(inputDataBlobName);
-    return inputBlob->getTensorDesc().getDims();
+    return inputDims;
 }
 
-std::vector<std::shared_ptr<VideoFrame> > IEGraph::getBatchData(cv::Size frameSize) {
-    std::vector<std::shared_ptr<VideoFrame>> vframes;
-    InferenceEngine::InferRequest::Ptr req;
-    std::chrono::high_resolution_clock::time_point startTime;
-    {
-        std::unique_lock<std::mutex> lock(mtxBusyRequests);
-        condVarBusyRequests.wait(lock, [&]() {
-            // wait until the pipeline is stopped or there are new InferRequests
-            return terminate || !busyBatchRequests.empty();
-        });
-        if (busyBatchRequests.empty()) {
-            return {}; // woke up because of termination, so leave if nothing to preces
-        }
-        vframes = std::move(busyBatchRequests.front().vfPtrVec);
-        req = std::move(busyBatchRequests.front().req);
-        startTime = std::move(busyBatchRequests.front().startTime);
-        busyBatchRequests.pop();
-    }
-
-    if (nullptr != req && InferenceEngine::OK == req->Wait(InferenceEngine::IInferRequest::WaitMode::RESULT_READY)) {
-        auto detections = postprocessing(req, outputDataBlobNames, frameSize);
-        for (decltype(detections.size()) i = 0; i < detections.size(); i ++) {
-            vframes[i]->detections = std::move(detections[i]);
-        }
+void IEGraph::postprocessBatch(BatchRequestDesc& desc, cv::Size frameSize) {
+    auto& req = desc.req;
+    if (InferenceEngine::OK == req->Wait(InferenceEngine::IInferRequest::WaitMode::RESULT_READY)) {
+        postprocessing(req, outputDataBlobNames, frameSize, desc.vfPtrVec);
         if (perfTimerInfer.enabled()) {
             auto endTime = std::chrono::high_resolution_clock::now();
-            perfTimerInfer.addValue(endTime - startTime);
+            perfTimerInfer.addValue(endTime - desc.startTime);
         }
     }
+}
 
-    if (nullptr != req) {
-        std::unique_lock<std::mutex> lock(mtxAvalableRequests);
-        availableRequests.push(std::move(req));
-        lock.unlock();
-        condVarAvailableRequests.notify_one();
-    }
+void IEGraph::releaseRequest(std::size_t requestIdx) {
+    // Request i always goes back to producer i % producers
+    availableRequests[requestIdx % producers]->tryPush(requestIdx);
+    --inFlight;
+}
 
-    return vframes;
+std::vector<std::shared_ptr<VideoFrame> > IEGraph::getBatchData(cv::Size frameSize) {
+    // wait until the pipeline is stopped and every started InferRequest was returned
+    auto drained = [this]() {
+        return terminate && 0 == activeProducers && 0 == inFlight;
+    };
+
+    // Batches are postprocessed and their requests reused as soon as they are popped.
+    // When sources keep their read order, a frame is handed out once every earlier
+    // frame of its source is, so a slow request holds back only the sources it carries
+    // frames of, and a frame not to infer waits only for those before it.
+    std::vector<std::shared_ptr<VideoFrame>> ready;
+    while (ready.empty()) {
+        BatchRequestDesc desc;
+        // without completion callbacks the oldest request is waited for even if younger ones have already finished
+        if (!batchResults.pop(desc, drained)) {
+            return {}; // woke up because of termination, so leave if nothing to preces
+        }
+        if (nullptr != desc.req) {
+            postprocessBatch(desc, frameSize);
+            releaseRequest(desc.requestIdx);
+        } else {
+            trackedTokens.tryPush('\0');
+        }
+        if (!sourceOrdered) {
+            return std::move(desc.vfPtrVec);
+        }
+        for (auto& frame : desc.vfPtrVec) {
+            if (frame->sourceIdx >= sourceOrders.size()) {
+                sourceOrders.resize(frame->sourceIdx + 1);
+            }
+            auto& order = sourceOrders[frame->sourceIdx];
+            const auto pos = static_cast<std::size_t>(frame->readSeq - order.nextSeq);
+            if (pos >= order.pending.size()) {
+                order.pending.resize(pos + 1);
+            }
+            order.pending[pos] = std::move(frame);
+            while (!order.pending.empty() && nullptr != order.pending.front()) {
+                ready.push_back(std::move(order.pending.front()));
+                order.pending.pop_front();
+                ++order.nextSeq;
+            }
+        }
+    }
+    return ready;
 }
 
 unsigned int IEGraph::getBatchSize() const {
@@ -260,38 +561,52 @@ void IEGraph::setDetectionConfidence(float conf) {
 
 IEGraph::~IEGraph() {
     terminate = true;
-    {
-        std::unique_lock<std::mutex> lock(mtxAvalableRequests);
-        bool ready = false;
-        while (!ready) {
-            std::unique_lock<std::mutex> lock(mtxBusyRequests);
-            if (!busyBatchRequests.empty()) {
-                auto& req = busyBatchRequests.front().req;
-                if (nullptr != req) {
-                    req->Wait(InferenceEngine::IInferRequest::WaitMode::RESULT_READY);
-                    availableRequests.push(std::move(req));
-                }
-                busyBatchRequests.pop();
-            }
-            if (availableRequests.size() == maxRequests) {
-                ready = true;
-            }
-        }
-        if (printPerfReport) {
-            slog::info << "Performance counts report" << slog::endl << slog::endl;
-            printPerformanceCounts(getFullDeviceName(ie, deviceName));
-        }
-        condVarAvailableRequests.notify_one();
+    for (auto& available : availableRequests) {
+        available->notifyAll();
     }
-    if (getterThread.joinable()) {
-        getterThread.join();
+    batchResults.notifyAll();
+    trackedTokens.notifyAll();
+    for (auto& thread : producerThreads) {
+        thread.join();
+    }
+
+    // Completion callbacks refer to this object, so no request may still be running
+    for (auto& req : requests) {
+        req->Wait(InferenceEngine::IInferRequest::WaitMode::RESULT_READY);
+    }
+    if (printPerfReport) {
+        slog::info << "Performance counts report" << slog::endl << slog::endl;
+        printPerformanceCounts(getFullDeviceName(ie, deviceName));
     }
 }
 
 IEGraph::Stats IEGraph::getStats() const {
-    return Stats{perfTimerPreprocess.getValue(), perfTimerInfer.getValue()};
+    float preprocessTime = 0.0f;
+    for (auto& timer : perfTimersPreprocess) {
+        preprocessTime += timer->getValue();
+    }
+    preprocessTime /= static_cast<float>(perfTimersPreprocess.size());
+    float queueDelay = 0.0f;
+    for (auto& timer : perfTimersQueueDelay) {
+        queueDelay += timer->getValue();
+    }
+    queueDelay /= static_cast<float>(perfTimersQueueDelay.size());
+
+    float batchFill = 0.0f;
+    std::uint64_t batches = batchesSubmitted;
+    std::uint64_t frames = framesSubmitted;
+    if (batches > lastBatchesSubmitted) {
+        batchFill = static_cast<float>(frames - lastFramesSubmitted) /
+                    static_cast<float>((batches - lastBatchesSubmitted) * batchSize);
+        lastBatchesSubmitted = batches;
+        lastFramesSubmitted = frames;
+    }
+
+    return Stats{preprocessTime, perfTimerInfer.getValue(),
+                 iePreprocessing ? "IE U8 resize" : "CPU fused resize",
+                 videoFramePool.getStats(), batchFill, queueDelay};
 }
 
 void IEGraph::printPerformanceCounts(std::string fullDeviceName) {
-    ::printPerformanceCounts(*availableRequests.front(), std::cout, fullDeviceName, false);
+    ::printPerformanceCounts(*requests.front(), std::cout, fullDeviceName, false);
 }
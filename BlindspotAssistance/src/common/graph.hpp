@@ -5,10 +5,10 @@
 #pragma once
 
 #include <vector>
-#include <chrono>
-#include <queue>
+#include <deque>
 #include <mutex>
-#include <condition_variable>
+#include <chrono>
+#include <cstdint>
 #include <thread>
 #include <functional>
 #include <atomic>
@@ -27,57 +27,104 @@
 #include <samples/slog.hpp>
 #include "perf_timer.hpp"
 #include "input.hpp"
-
-void loadImageToIEGraph(cv::Mat img, void* ie_buffer);
+#include "blocking_ring.hpp"
+#include "object_pool.hpp"
 
 class VideoFrame;
 
 class IEGraph{
 private:
-    PerfTimer perfTimerPreprocess;
+    std::vector<std::unique_ptr<PerfTimer>> perfTimersPreprocess;  // one per producer
+    std::vector<std::unique_ptr<PerfTimer>> perfTimersQueueDelay;  // one per producer
     PerfTimer perfTimerInfer;
 
     float confidenceThreshold;
 
     std::size_t batchSize;
+    std::chrono::milliseconds batchDeadline;
+    bool dynamicBatch;
+    std::atomic<std::uint64_t> batchesSubmitted = {0};
+    std::atomic<std::uint64_t> framesSubmitted = {0};
+    mutable std::uint64_t lastBatchesSubmitted = 0;
+    mutable std::uint64_t lastFramesSubmitted = 0;
 
     std::string modelPath;
+    std::string compiledCacheDir;
     std::string cpuExtensionPath;
     std::string cldnnConfigPath;
+    std::string cpuStreams;
+    std::size_t cpuThreads;
+    std::string cpuBindThread;
 
     std::string inputDataBlobName;
+    InferenceEngine::SizeVector inputDims;
     std::vector<std::string> outputDataBlobNames;
 
+    bool iePreprocessing;
+
     bool printPerfReport;
     std::string deviceName;
 
     InferenceEngine::Core ie;
-    std::queue<InferenceEngine::InferRequest::Ptr> availableRequests;
+    std::vector<InferenceEngine::InferRequest::Ptr> requests;
+    // Indices into requests, one ring per producer
+    std::vector<std::unique_ptr<BlockingRing<std::size_t>>> availableRequests;
 
     struct BatchRequestDesc {
         std::vector<std::shared_ptr<VideoFrame>> vfPtrVec;
+        // Null for a frame not to infer, which is handed out without a request
         InferenceEngine::InferRequest::Ptr req;
+        std::size_t requestIdx = 0;
         std::chrono::high_resolution_clock::time_point startTime;
     };
-    std::queue<BatchRequestDesc> busyBatchRequests;
+    // Batches for the main thread: submitted requests in submission order, or finished ones
+    // in completion order with completion callbacks, and frames not to infer as they are read
+    BlockingRing<BatchRequestDesc> batchResults;
+    // One token per frame not to infer that may wait in batchResults
+    BlockingRing<char> trackedTokens;
+
+    bool completionCallbacks;
+    bool orderedResults;
+    // Every source hands out its frames in read order, independently of the others
+    bool sourceOrdered;
+    // Completion callback mode: a submitted batch waits here until its request finishes
+    std::vector<BatchRequestDesc> requestSlots;
+
+    std::mutex readSeqMutex;
+    std::vector<std::uint64_t> readSeqs;  // next read sequence number per source
+    struct SourceOrder {
+        std::uint64_t nextSeq = 0;
+        std::deque<std::shared_ptr<VideoFrame>> pending;  // frame nextSeq + i at i, null until it completes
+    };
+    std::vector<SourceOrder> sourceOrders;  // main thread only
 
     std::size_t maxRequests = 0;
+    std::size_t producers = 1;
 
     std::atomic_bool terminate = {false};
-    std::mutex mtxAvalableRequests;
-    std::mutex mtxBusyRequests;
-    std::condition_variable condVarAvailableRequests;
-    std::condition_variable condVarBusyRequests;
+    std::atomic<std::size_t> activeProducers = {0};
+    std::atomic<std::size_t> inFlight = {0};
 
-    using GetterFunc = std::function<bool(VideoFrame&)>;
+    // Called with the index of the calling producer and the point in time the frame is needed by
+    using GetterFunc = std::function<FrameStatus(VideoFrame&, std::size_t, FrameDeadline)>;
     GetterFunc getter;
-    using PostprocessingFunc = std::function<std::vector<Detections>(InferenceEngine::InferRequest::Ptr, const std::vector<std::string>&, cv::Size)>;
+    using PostprocessingFunc = std::function<void(InferenceEngine::InferRequest::Ptr, const std::vector<std::string>&, cv::Size,
+                                                  const std::vector<std::shared_ptr<VideoFrame>>&)>;
     PostprocessingFunc postprocessing;
     using PostLoadFunc = std::function<void (const std::vector<std::string>&, InferenceEngine::CNNNetwork&)>;
     PostLoadFunc postLoad;
-    std::thread getterThread;
+    using InputReadyFunc = std::function<void(const InferenceEngine::SizeVector&)>;
+    InputReadyFunc inputReady;
+    std::vector<std::thread> producerThreads;
+
+    ObjectPool<VideoFrame> videoFramePool;
 
     void initNetwork(const std::string& deviceName);
+    // Runs every request at every batch size in use until the latency settles, returns the number of rounds
+    std::size_t warmUp();
+    void produce(std::size_t producer);
+    void postprocessBatch(BatchRequestDesc& desc, cv::Size frameSize);
+    void releaseRequest(std::size_t requestIdx);
 
 public:
     struct InitParams {
@@ -85,15 +132,44 @@ public:
         std::size_t maxRequests = 5;
         bool collectStats = false;
         bool reportPerf = false;
+        // Let the Inference Engine resize U8 NHWC input instead of preprocessing on the CPU
+        bool iePreprocessing = false;
+        // Collect requests in completion order through completion callbacks instead of waiting on the oldest one
+        bool completionCallbacks = false;
+        // With completionCallbacks, still return the frames of every source in read order
+        bool orderedResults = false;
+        // The getter may mark frames not to infer. They are handed out as soon as they are read,
+        // after the earlier frames of their source, so every source keeps its read order
+        bool trackedFrames = false;
+        // Threads that fill and submit batches; producer i owns requests i, i + producers, ...
+        std::size_t producers = 1;
+        // Start a partially filled batch once its first frame has waited this long; 0 waits for a full batch
+        std::chrono::milliseconds batchDeadline{0};
+        // Infer partial batches with the plugin's dynamic batching instead of padding them
+        bool dynamicBatch = false;
         std::string modelPath;
+        // Directory for compiled networks exported by the plugin and imported on later starts; empty disables it
+        std::string compiledCacheDir;
         std::string cpuExtPath;
         std::string cldnnConfigPath;
+        // CPU plugin execution; empty streams leave them to the plugin, "auto" derives them with
+        // autoCpuStreams(), otherwise they give their number; 0 threads leaves the thread count to the plugin
+        std::string cpuStreams;
+        std::size_t cpuThreads = 0;
+        // CPU thread binding: "NO", "YES" (to cores) or "NUMA" (to NUMA nodes)
+        std::string cpuBindThread = "NO";
         std::string deviceName;
         PostLoadFunc postLoadFunc = nullptr;
+        // Called from the constructor with the input dimensions as soon as they are known,
+        // so work that depends on them may start while the network is still compiling
+        InputReadyFunc inputReadyFunc = nullptr;
     };
 
     explicit IEGraph(const InitParams& p);
 
+    // CPU throughput streams for maxRequests requests on cpuThreads threads, or on the physical cores if 0
+    static std::size_t autoCpuStreams(std::size_t maxRequests, std::size_t cpuThreads);
+
     void start(GetterFunc getterFunc, PostprocessingFunc postprocessingFunc);
 
     bool isRunning();
@@ -111,6 +187,10 @@ public:
     struct Stats {
         float preprocessTime;
         float inferTime;
+        const char* preprocessPath;
+        ObjectPoolStats videoFramePool;
+        float batchFill;   // average share of batch slots holding a frame since the previous call
+        float queueDelay;  // time from the first frame of a batch to its submission
     };
 
     Stats getStats() const;
@@ -6,15 +6,21 @@
 
 #include <atomic>
 #include <chrono>
+#include <deque>
+#include <exception>
+#include <future>
 #include <memory>
 #include <numeric>
 #include <queue>
+#include <stdexcept>
 #include <string>
 #include <utility>
 
 #include "perf_timer.hpp"
 
 #include "decoder.hpp"
+#include "frame_pool.hpp"
+#include "motion_gate.hpp"
 #include "threading.hpp"
 
 #ifdef USE_NATIVE_CAMERA_API
@@ -30,7 +36,52 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
+
+#include "mjpeg_index.hpp"
+#endif
+
+namespace {
+template<typename Pred>
+bool waitForFrame(std::condition_variable& condVar, std::unique_lock<std::mutex>& lock,
+                  FrameDeadline deadline, Pred pred) {
+    if (FrameDeadline::max() == deadline) {
+        condVar.wait(lock, pred);
+        return true;
+    }
+    return condVar.wait_until(lock, deadline, pred);
+}
+
+using ReadyTime = std::chrono::steady_clock::time_point;
+
+// A frame waiting to be read, with the time it became available
+struct QueuedFrame {
+    bool success = false;
+    cv::Mat frame;
+    ReadyTime arrival;
+    ReadyTime captured;  // when the source produced it; arrival may be later while the queue was full
+};
+
+// Decodes a single frame in the calling thread's time, whatever the decoder mode.
+// owner keeps the compressed data alive and is released once it is decoded.
+template<typename Owner>
+cv::Mat decodeNow(Decoder& decoder, const void* data, size_t size, unsigned width, unsigned height, Owner&& owner) {
+    std::promise<cv::Mat> decoded;
+    auto result = decoded.get_future();
+    decoder.decode(data, size, width, height,
+                   [&decoded, o = std::forward<Owner>(owner)](cv::Mat&& img) mutable {
+        o = {};
+        decoded.set_value(std::move(img));
+    });
+    return result.get();
+}
+
+#if defined(USE_LIBVA) || defined(USE_NATIVE_CAMERA_API)
+std::unique_ptr<MotionGate> makeMotionGate(float threshold) {
+    return threshold > 0.0f ? std::unique_ptr<MotionGate>(new MotionGate(threshold)) : nullptr;
+}
 #endif
+}  // namespace
 
 class VideoSource {
 public:
@@ -38,10 +89,32 @@ public:
 
     virtual void start() = 0;
 
-    virtual bool read(VideoFrame& frame) = 0;
+    virtual FrameStatus read(VideoFrame& frame, FrameDeadline deadline) = 0;
+
+    // See VideoSources::readySince()
+    virtual ReadyTime readySince() const = 0;
 
     virtual float getAvgReadTime() const = 0;
 
+    virtual float getDecodingLatency() const {
+        return 0.0f;
+    }
+
+    // Average time from capture to read of the frames handed out
+    virtual float getFrameAge() const {
+        return 0.0f;
+    }
+
+    // Frames discarded unread because a newer one replaced them
+    virtual std::uint64_t getDroppedFrames() const {
+        return 0;
+    }
+
+    // Share of frames the motion gate skipped since the previous call
+    virtual float takeMotionSkipRate() {
+        return 0.0f;
+    }
+
     virtual ~VideoSource();
 };
 
@@ -61,15 +134,19 @@ struct VideoStream {
     std::unique_ptr<void, std::function<void(void*)>> ptr;
     size_t length;
 
-    size_t frame_offset;
-    size_t next_frame_offset;
+    // Built once when the file is opened, so moving to any frame is a table lookup
+    std::vector<MjpegFrameInfo> index;
+    size_t frame_idx = 0;
+    const bool loop;
 
     mcam::file_descriptor fd;
 
     using stream_t = unsigned char;
 
-    explicit VideoStream(const std::string& filepath)
-        : ptr(0, [](void*){}), fd(open(filepath.c_str(), O_RDONLY)) {
+    static constexpr size_t ReadaheadFrames = 4;
+
+    VideoStream(const std::string& filepath, bool loop_, bool useIndexFile)
+        : ptr(0, [](void*){}), loop(loop_), fd(open(filepath.c_str(), O_RDONLY)) {
         struct stat sb;
         if (!fd.valid())
             throw std::runtime_error(std::string("Cannot open input file: ") + std::string(strerror(errno)));
@@ -82,70 +159,82 @@ struct VideoStream {
 
         auto l = sb.st_size;
         ptr = std::unique_ptr<void, std::function<void(void*)>>(p, [l](void* _p) { munmap(_p, l); });
+        madvise(p, length, MADV_SEQUENTIAL);
+
+        const std::string indexPath = filepath + ".idx";
+        if (!useIndexFile || !loadMjpegIndex(indexPath, length, sb.st_mtime, index)) {
+            index = indexMjpegStream(static_cast<const stream_t*>(p), length);
+            if (useIndexFile) {
+                saveMjpegIndex(indexPath, length, sb.st_mtime, index);
+            }
+        }
+        if (index.empty())
+            throw std::runtime_error("No JPEG frames found in " + filepath);
 
-        advance_frame();
+        seek(0);
     }
 
     VideoStream (const VideoStream&) = delete;
     VideoStream (VideoStream&&) = delete;
 
-    void update_frame_dims() {
-        auto p = static_cast<stream_t*>(frame.ptr);
-        size_t header_offset = 0;
-        bool is_marker_found = false;
-        while (header_offset < frame.length && !is_marker_found) {
-            if (p[header_offset] == static_cast<stream_t>(0xFF) &&
-                p[header_offset + 1] == static_cast<stream_t>(0xC0))
-                is_marker_found = true;
-            else
-                header_offset++;
-        }
-        if (is_marker_found) {
-            size_t offset = header_offset;
-            offset += 2;  // skip header marker
-            offset += 2;  // skip header size
-            offset += 1;  // skip precision
-            frame.height = p[offset + 0] * 256 + p[offset + 1];
-            frame.width = p[offset + 2] * 256 + p[offset + 3];
-        } else {
-            assert(false);
-        }
+    size_t frame_count() const {
+        return index.size();
     }
 
-    void advance_frame() {
-        // Loop
-        if (next_frame_offset >= length) {
-            next_frame_offset = 0;
-        }
+    void seek(size_t idx) {
+        assert(idx < index.size());
+        frame_idx = idx;
+        const auto& info = index[idx];
+        frame.ptr = static_cast<stream_t*>(ptr.get()) + info.offset;
+        frame.offset = info.offset;
+        frame.length = info.length;
+        frame.width = static_cast<int>(info.width);
+        frame.height = static_cast<int>(info.height);
+        prefetch(idx + 1);
+    }
 
-        frame_offset = next_frame_offset;
-        auto p = static_cast<stream_t*>(ptr.get());
-        while (next_frame_offset < length) {
-            if (p[next_frame_offset] == static_cast<stream_t>(0xFF) &&
-                p[next_frame_offset + 1] == static_cast<stream_t>(0xD9) )
-                break;
-            else
-                next_frame_offset++;
+    // Returns false at the end of a stream that does not loop
+    bool advance_frame() {
+        if (frame_idx + 1 < index.size()) {
+            seek(frame_idx + 1);
+            return true;
         }
-        next_frame_offset += 2;
-        frame.length = next_frame_offset - frame_offset;
-        frame.ptr = &(p[frame_offset]);
-        update_frame_dims();
+        if (!loop)
+            return false;
+        seek(0);
+        return true;
+    }
+
+    // Asks the kernel to read the next few frames ahead of the decoder
+    void prefetch(size_t idx) {
+        if (idx >= index.size())
+            return;
+        static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t last = std::min(idx + ReadaheadFrames, index.size()) - 1;
+        const size_t begin = index[idx].offset / pageSize * pageSize;
+        const size_t end = index[last].offset + index[last].length;
+        madvise(static_cast<stream_t*>(ptr.get()) + begin, end - begin, MADV_WILLNEED);
     }
 };
 
 class VideoSourceStreamFile : public VideoSource {
-    using queue_elem_t = std::pair<bool, cv::Mat>;
+    using queue_elem_t = QueuedFrame;
     using queue_t = std::queue<queue_elem_t>;
 
     VideoSources& parent;
 
     VideoStream stream;
+    Decoder decoder;
+    // Decode in read() only the frame handed out instead of every frame in a work thread
+    const bool lazyDecode;
+    bool streamEnded = false;
+    // Frames whose scene did not change are neither decoded nor queued
+    std::unique_ptr<MotionGate> motionGate;
 
     std::atomic_bool running = {false};
-    std::atomic_bool is_decoding = {false};
+    bool is_decoding = false;  // guarded by mutex
 
-    std::mutex mutex;
+    mutable std::mutex mutex;
     std::thread workThread;
     std::condition_variable condVar;
     std::condition_variable hasFrame;
@@ -162,11 +251,15 @@ public:
                           bool async,
                           bool collectStats_,
                           const std::string& name,
+                          bool loopVideo,
                           size_t queueSize_,
                           size_t pollingTimeMSec_,
                           bool realFps_):
         parent(p),
-        stream(name),
+        stream(name, loopVideo, p.mjpegIndexFile),
+        decoder(p.decoderSettings),
+        lazyDecode(p.lazyDecode),
+        motionGate(makeMotionGate(p.motionThreshold)),
         queueSize(queueSize_),
         perfTimer(collectStats_ ? PerfTimer::DefaultIterationsCount : 0) { }
 
@@ -174,20 +267,40 @@ public:
         return running;
     }
 
+    bool frameChanged() {
+        return !motionGate || motionGate->changed(static_cast<const unsigned char*>(stream.frame.ptr),
+                                                  stream.frame.length);
+    }
+
     void start() {
         running = true;
+        if (lazyDecode) {
+            return;  // a file always has its next frame at hand
+        }
         workThread = std::thread([&]() {
             while (running) {
+                if (!frameChanged()) {
+                    if (stream.advance_frame()) {
+                        continue;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        frameQueue.push({false, cv::Mat(), std::chrono::steady_clock::now()});
+                    }
+                    hasFrame.notify_one();
+                    parent.notifyFrame();
+                    break;
+                }
                 {
                     cv::Mat frame;
                     {
-                        is_decoding = true;
-                        std::unique_lock<std::mutex> lock(parent.decode_mutex);
-
-                        parent.decoder.decode(stream.frame.ptr, stream.frame.length, stream.frame.width, stream.frame.height,
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            is_decoding = true;
+                        }
+                        decoder.decode(stream.frame.ptr, stream.frame.length, stream.frame.width, stream.frame.height,
                             [this](cv::Mat&& img) mutable {
                             bool success = !img.empty();
-                            frameQueue.push({success, std::move(img)});
                             if (perfTimer.enabled()) {
                                 auto prev = lastFrameTime;
                                 auto current = clock::now();
@@ -197,16 +310,30 @@ public:
                                 }
                                 lastFrameTime = current;
                             }
-                            is_decoding = false;
-                            condVar.notify_one();
+                            {
+                                // The reader thread checks is_decoding under the mutex before it waits
+                                std::lock_guard<std::mutex> lock(mutex);
+                                frameQueue.push({success, std::move(img), std::chrono::steady_clock::now()});
+                                is_decoding = false;
+                                condVar.notify_one();
+                            }
+                            parent.notifyFrame();
                         });
-                        stream.advance_frame();
                     }
+                    const bool more = stream.advance_frame();
 
                     std::unique_lock<std::mutex> lock(mutex);
                     condVar.wait(lock, [&]() {
                         return !is_decoding && (frameQueue.size() < queueSize || !running);
                     });
+                    if (!more) {
+                        // out of frames: the reader gets Finished after the queued ones
+                        frameQueue.push({false, cv::Mat(), std::chrono::steady_clock::now()});
+                        lock.unlock();
+                        hasFrame.notify_one();
+                        parent.notifyFrame();
+                        break;
+                    }
                 }
                 hasFrame.notify_one();
             }
@@ -221,49 +348,94 @@ public:
         }
     }
 
-    bool read(VideoFrame& frame)  {
+    ReadyTime readySince() const override {
+        if (lazyDecode) {
+            return ReadyTime();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!frameQueue.empty()) {
+            return frameQueue.front().arrival;
+        }
+        return running ? ReadyTime::max() : ReadyTime();
+    }
+
+    FrameStatus read(VideoFrame& frame, FrameDeadline deadline) override {
         queue_elem_t elem;
 
         if (!running)
-            return false;
+            return FrameStatus::Finished;
+
+        if (lazyDecode) {
+            if (streamEnded)
+                return FrameStatus::Finished;
+            // Skip unchanged frames, but at most one pass over the file per read
+            for (size_t skipped = 0; skipped < stream.frame_count() && !frameChanged(); ++skipped) {
+                if (!stream.advance_frame()) {
+                    streamEnded = true;
+                    return FrameStatus::Finished;
+                }
+            }
+            frame.frame = decodeNow(decoder, stream.frame.ptr, stream.frame.length,
+                                    stream.frame.width, stream.frame.height, 0);
+            streamEnded = !stream.advance_frame();
+            return frame.frame.empty() ? FrameStatus::Finished : FrameStatus::Ready;
+        }
 
         {
             std::unique_lock<std::mutex> lock(mutex);
-            hasFrame.wait(lock, [&]() {
-                return !frameQueue.empty() || !running;
-            });
+            if (!waitForFrame(hasFrame, lock, deadline, [&]() {
+                    return !frameQueue.empty() || !running;
+                })) {
+                return FrameStatus::NotReady;
+            }
+            if (frameQueue.empty())
+                return FrameStatus::Finished;
             elem = std::move(frameQueue.front());
             frameQueue.pop();
         }
         condVar.notify_one();
-        frame.frame = std::move(elem.second);
+        frame.frame = std::move(elem.frame);
+        frame.captureTime = elem.arrival;  // decoded from the file
 
-        return elem.first && running;
+        return elem.success && running ? FrameStatus::Ready : FrameStatus::Finished;
     }
 
     float getAvgReadTime() const {
         return perfTimer.getValue();
     }
+
+    float getDecodingLatency() const override {
+        return decoder.getStats().decoding_latency;
+    }
+
+    float takeMotionSkipRate() override {
+        return motionGate ? motionGate->takeSkipRate() : 0.0f;
+    }
 };
 
 #endif
 
 class VideoSourceOCV : public VideoSource {
+    VideoSources& parent;
     PerfTimer perfTimer;
     std::thread workThread;
     const bool isAsync;
     std::atomic_bool running = {true};
     std::string videoName;
 
-    std::mutex mutex;
+    mutable std::mutex mutex;
     std::condition_variable condVar;
     std::condition_variable hasFrame;
-    std::queue<std::pair<bool, cv::Mat>> queue;
+    std::queue<QueuedFrame> queue;
 
     cv::VideoCapture source;
     bool loopVideo;
 
     bool realFps;
+    // Keep only the newest frame instead of blocking the capture on a full queue; live cameras only
+    const bool latestFrame;
+    std::atomic<std::uint64_t> droppedFrames = {0};
+    PerfTimer frameAgeTimer;
 
     const size_t queueSize = 1;
     const size_t pollingTimeMSec = 1000;
@@ -275,8 +447,8 @@ class VideoSourceOCV : public VideoSource {
     void startImpl();
 
 public:
-    VideoSourceOCV(bool async, bool collectStats_, const std::string& name, bool loopVideo,
-                size_t queueSize_, size_t pollingTimeMSec_, bool realFps_);
+    VideoSourceOCV(VideoSources& p, bool async, bool collectStats_, const std::string& name, bool loopVideo,
+                size_t queueSize_, size_t pollingTimeMSec_, bool realFps_, bool latestFrame_);
 
     ~VideoSourceOCV();
 
@@ -286,13 +458,23 @@ public:
 
     void stop();
 
-    bool read(cv::Mat& frame);
-    bool read(VideoFrame& frame);
+    FrameStatus read(cv::Mat& frame, FrameDeadline deadline, ReadyTime& captured);
+    FrameStatus read(VideoFrame& frame, FrameDeadline deadline) override;
+
+    ReadyTime readySince() const override;
 
     float getAvgReadTime() const {
         return perfTimer.getValue();
     }
 
+    float getFrameAge() const override {
+        return frameAgeTimer.getValue();
+    }
+
+    std::uint64_t getDroppedFrames() const override {
+        return droppedFrames;
+    }
+
 private:
     template<bool CollectStats>
     static void thread_fn(VideoSourceOCV*);
@@ -312,6 +494,25 @@ class VideoSourceNative : public VideoSource {
     cv::Mat dummyFrame;
     std::size_t frameIdx = 0;
     queue_t frameQueue;
+
+    // Lazy decoding: camera buffers wait here compressed and only the one read is decoded
+    struct CompressedFrame {
+        mcam::camera::frame frame;
+        unsigned width = 0;
+        unsigned height = 0;
+        ReadyTime arrival;
+    };
+    const bool lazyDecode = false;
+    mutable std::mutex compressedMutex;
+    std::condition_variable hasCompressed;
+    std::deque<CompressedFrame> compressed;
+    std::atomic<std::uint64_t> droppedFrames = {0};
+
+    // Frames whose scene did not change are returned to the camera undecoded. The
+    // last frame is then not repeated either, so the camera is only read on motion.
+    std::unique_ptr<MotionGate> motionGate;
+
+    Decoder decoder;
     mcam::camera camera;
     PerfTimer perfTimer;
 
@@ -322,6 +523,8 @@ class VideoSourceNative : public VideoSource {
                       const mcam::camera::settings& settings,
                       mcam::camera::frame frame);
 
+    FrameStatus readCompressed(VideoFrame& frame, FrameDeadline deadline);
+
 public:
     VideoSourceNative(VideoSources& p, mcam::controller& ctrl,
            const std::string& source, const mcam::camera::settings& settings,
@@ -333,11 +536,25 @@ public:
 
     bool isRunning() const override;
 
-    bool read(VideoFrame& frame);
+    FrameStatus read(VideoFrame& frame, FrameDeadline deadline) override;
+
+    ReadyTime readySince() const override;
 
     float getAvgReadTime() const {
         return perfTimer.getValue();
     }
+
+    float getDecodingLatency() const override {
+        return decoder.getStats().decoding_latency;
+    }
+
+    std::uint64_t getDroppedFrames() const override {
+        return droppedFrames;
+    }
+
+    float takeMotionSkipRate() override {
+        return motionGate ? motionGate->takeSkipRate() : 0.0f;
+    }
 };
 
 
@@ -347,6 +564,9 @@ VideoSourceNative::VideoSourceNative(VideoSources& p, mcam::controller& ctrl,
     parent(p),
     queueSize(static_cast<int>(queueSize)),
     realFps(realFps),
+    lazyDecode(p.lazyDecode),
+    motionGate(makeMotionGate(p.motionThreshold)),
+    decoder(p.decoderSettings),
     camera(ctrl, source, [this](
            mcam::camera::frame_status status,
            const mcam::camera::settings& settings,
@@ -364,14 +584,31 @@ void VideoSourceNative::start() {
     // nothing
 }
 
-bool VideoSourceNative::isRunning() const override {
+bool VideoSourceNative::isRunning() const {
     return true;
 }
 
 void VideoSourceNative::frameHandler(mcam::camera::frame_status status,
                   const mcam::camera::settings& settings,
                   mcam::camera::frame frame) {
-    if (status == mcam::camera::frame_status::ok) {
+    if (status == mcam::camera::frame_status::ok && motionGate &&
+        !motionGate->changed(static_cast<const unsigned char*>(frame.data()), frame.size())) {
+        return;  // the buffer goes back to the camera
+    }
+    if (status == mcam::camera::frame_status::ok && lazyDecode) {
+        assert(frame.valid());
+        {
+            std::lock_guard<std::mutex> lock(compressedMutex);
+            // The camera has queueSize buffers; leave it at least one to capture into
+            if (compressed.size() >= static_cast<size_t>(std::max(1, queueSize - 1))) {
+                compressed.pop_front();  // returns the oldest buffer to the camera undecoded
+                ++droppedFrames;
+            }
+            compressed.push_back({std::move(frame), settings.width, settings.height, std::chrono::steady_clock::now()});
+        }
+        hasCompressed.notify_one();
+        parent.notifyFrame();
+    } else if (status == mcam::camera::frame_status::ok) {
         if (frameQueue.size() < queueSize) {
             (void)settings;
             assert(mcam::make_4cc('M', 'J', 'P', 'G') ==
@@ -380,9 +617,7 @@ void VideoSourceNative::frameHandler(mcam::camera::frame_status status,
             auto data = frame.data();
             auto size = frame.size();
 
-            std::unique_lock<std::mutex> lock(parent.decode_mutex);
-
-            parent.decoder.decode(
+            decoder.decode(
                         data, size, settings.width, settings.height,
             [this, fr = std::move(frame)](cv::Mat&& img) mutable {
                 fr = {};
@@ -398,14 +633,69 @@ void VideoSourceNative::frameHandler(mcam::camera::frame_status status,
 
                     lastFrameTime = current;
                 }
+                parent.notifyFrame();
             });
         }
     }
 }
 
-bool VideoSourceNative::read(VideoFrame& frame) {
+// Queued camera frames carry no timestamp, so a ready camera reports the epoch
+// and the scheduler ages it by the time since it was last served
+ReadyTime VideoSourceNative::readySince() const {
+    if (!realFps && !motionGate && !dummyFrame.empty()) {
+        return ReadyTime();  // the last frame is repeated
+    }
+    if (lazyDecode) {
+        std::lock_guard<std::mutex> lock(compressedMutex);
+        return compressed.empty() ? ReadyTime::max() : compressed.front().arrival;
+    }
+    return frameQueue.empty() ? ReadyTime::max() : ReadyTime();
+}
+
+// With -real_input_fps frames are decoded in order, otherwise the newest one is
+// decoded and the older ones are dropped undecoded
+FrameStatus VideoSourceNative::readCompressed(VideoFrame& frame, FrameDeadline deadline) {
+    CompressedFrame elem;
+    {
+        std::unique_lock<std::mutex> lock(compressedMutex);
+        if (realFps || motionGate || dummyFrame.empty()) {
+            if (!waitForFrame(hasCompressed, lock, deadline, [&]() { return !compressed.empty(); })) {
+                return FrameStatus::NotReady;
+            }
+        }
+        if (compressed.empty()) {
+            frame.frame = dummyFrame;
+            return FrameStatus::Ready;
+        }
+        if (realFps) {
+            elem = std::move(compressed.front());
+            compressed.pop_front();
+        } else {
+            elem = std::move(compressed.back());
+            droppedFrames += compressed.size() - 1;
+            compressed.clear();
+        }
+    }
+    auto data = elem.frame.data();
+    auto size = elem.frame.size();
+    cv::Mat img = decodeNow(decoder, data, size, elem.width, elem.height, std::move(elem.frame));
+    if (img.empty()) {
+        return FrameStatus::Finished;
+    }
+    if (!realFps) {
+        dummyFrame = img;
+    }
+    frame.frame = std::move(img);
+    return FrameStatus::Ready;
+}
+
+// Without -real_input_fps the last frame is repeated, so the deadline only matters for the TBB queue wait
+FrameStatus VideoSourceNative::read(VideoFrame& frame, FrameDeadline deadline) {
+    if (lazyDecode) {
+        return readCompressed(frame, deadline);
+    }
     queue_elem_t elem;
-    if (realFps) {
+    if (realFps || motionGate) {
 #ifdef USE_TBB
         frameQueue.pop(elem);
 #else
@@ -429,7 +719,7 @@ bool VideoSourceNative::read(VideoFrame& frame) {
         }
     }
     frame.frame = std::move(elem.second);
-    return elem.first;
+    return elem.first ? FrameStatus::Ready : FrameStatus::Finished;
 }
 #endif  // USE_NATIVE_CAMERA_API
 
@@ -459,14 +749,18 @@ bool VideoSourceOCV::readFrame(cv::Mat& frame) {
     }
 }
 
-VideoSourceOCV::VideoSourceOCV(bool async, bool collectStats_,
+VideoSourceOCV::VideoSourceOCV(VideoSources& p, bool async, bool collectStats_,
                          const std::string& name, bool loopVideo, size_t queueSize_,
-                         size_t pollingTimeMSec_, bool realFps_):
+                         size_t pollingTimeMSec_, bool realFps_, bool latestFrame_):
+        parent(p),
         perfTimer(collectStats_ ? PerfTimer::DefaultIterationsCount : 0),
         isAsync(async), videoName(name),
         loopVideo(loopVideo),
         realFps(realFps_),
-        queueSize(queueSize_),
+        // A file has no newer frame to wait for, dropping its frames would only make it decode flat out
+        latestFrame(latestFrame_ && isNumeric(name)),
+        frameAgeTimer(collectStats_ ? PerfTimer::DefaultIterationsCount : 0),
+        queueSize(latestFrame ? 1 : queueSize_),
         pollingTimeMSec(pollingTimeMSec_) {
     if (isNumeric(videoName)) {
         if (!source.open(std::stoi(videoName))) {
@@ -492,16 +786,28 @@ template<bool CollectStats>
 void VideoSourceOCV::thread_fn(VideoSourceOCV *vs) {
     while (vs->running) {
         cv::Mat frame;
+        frame.allocator = &getFramePool();
         const bool result = vs->readFrame<CollectStats>(frame);
+        const auto captured = std::chrono::steady_clock::now();
         if (!result) {
             vs->running = false; // stop() also affects running, so override it only when out of frames
         }
         std::unique_lock<std::mutex> lock(vs->mutex);
-        vs->condVar.wait(lock, [&]() {
-            return vs->queue.size() < vs->queueSize || !vs->running; // queue has space or source ran out of frames
-        });
-        vs->queue.push({result, frame});
+        if (vs->latestFrame) {
+            // The mailbox holds at most one frame, an unread one is replaced by the newer capture
+            if (!vs->queue.empty()) {
+                vs->queue.pop();
+                ++vs->droppedFrames;
+            }
+        } else {
+            vs->condVar.wait(lock, [&]() {
+                return vs->queue.size() < vs->queueSize || !vs->running; // queue has space or source ran out of frames
+            });
+        }
+        vs->queue.push({result, std::move(frame), std::chrono::steady_clock::now(), captured});
         vs->hasFrame.notify_one();
+        lock.unlock();
+        vs->parent.notifyFrame();
     }
 }
 
@@ -531,29 +837,53 @@ void VideoSourceOCV::stop() {
     }
 }
 
-bool VideoSourceOCV::read(cv::Mat& frame) {
+FrameStatus VideoSourceOCV::read(cv::Mat& frame, FrameDeadline deadline, ReadyTime& captured) {
     if (isAsync) {
         bool res;
         {
             std::unique_lock<std::mutex> lock(mutex);
-            hasFrame.wait(lock, [&]() {
-                return !queue.empty() || !running;
-            });
-            res = queue.front().first;
-            frame = queue.front().second;
-            if (realFps || queue.size() > 1 || queueSize == 1) {
+            if (!waitForFrame(hasFrame, lock, deadline, [&]() {
+                    return !queue.empty() || !running;
+                })) {
+                return FrameStatus::NotReady;
+            }
+            if (queue.empty()) {
+                return FrameStatus::Finished;
+            }
+            res = queue.front().success;
+            captured = queue.front().captured;
+            if (res && frameAgeTimer.enabled()) {
+                frameAgeTimer.addValue(std::chrono::steady_clock::now() - captured);
+            }
+            if (realFps || latestFrame || queue.size() > 1 || queueSize == 1) {
+                frame = std::move(queue.front().frame);
                 queue.pop();
+            } else {
+                frame = queue.front().frame;
             }
         }
         condVar.notify_one();
-        return res;
+        return res ? FrameStatus::Ready : FrameStatus::Finished;
     } else {
-        return source.read(frame);
+        const bool res = source.read(frame);
+        captured = std::chrono::steady_clock::now();
+        return res ? FrameStatus::Ready : FrameStatus::Finished;
     }
 }
 
-bool VideoSourceOCV::read(VideoFrame& frame) {
-    return read(frame.frame);
+FrameStatus VideoSourceOCV::read(VideoFrame& frame, FrameDeadline deadline) {
+    return read(frame.frame, deadline, frame.captureTime);
+}
+
+ReadyTime VideoSourceOCV::readySince() const {
+    if (!isAsync) {
+        return ReadyTime();  // reads the capture directly
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!queue.empty()) {
+        return queue.front().arrival;
+    }
+    return running ? ReadyTime::max() : ReadyTime();  // a stopped source reports Finished at once
 }
 
 namespace {
@@ -565,10 +895,12 @@ Decoder::Settings makeDecoderSettings(bool collectStats, std::size_t queueSize,
     ret.num_buffers = static_cast<unsigned>(queueSize);
     ret.output_width = width;
     ret.output_height = height;
-#elif defined(USE_TBB)
-    ret.mode = Decoder::Mode::Async;
 #else
-    ret.mode = Decoder::Mode::Immediate;
+    // Decoded on the TBB arena or the decode worker pool, at most queueSize frames per stream at once
+    ret.mode = Decoder::Mode::Async;
+    ret.num_buffers = static_cast<unsigned>(queueSize);
+    ret.output_width = width;
+    ret.output_height = height;
 #endif
     ret.collect_stats = collectStats;
     return ret;
@@ -576,11 +908,15 @@ Decoder::Settings makeDecoderSettings(bool collectStats, std::size_t queueSize,
 }  // namespace
 
 VideoSources::VideoSources(const InitParams& p):
-    decoder(makeDecoderSettings(p.collectStats, p.queueSize, p.expectedWidth,
-                                p.expectedHeight)),
+    decoderSettings(makeDecoderSettings(p.collectStats, p.queueSize, p.expectedWidth,
+                                        p.expectedHeight)),
     isAsync(p.isAsync),
     collectStats(p.collectStats),
     realFps(p.realFps),
+    mjpegIndexFile(p.mjpegIndexFile),
+    latestFrame(p.latestFrame),
+    lazyDecode(p.lazyDecode),
+    motionThreshold(p.motionThreshold),
     queueSize(p.queueSize),
     pollingTimeMSec(p.pollingTimeMSec) {}
 
@@ -596,6 +932,34 @@ bool VideoSources::isRunning() const {
 }
 
 void VideoSources::openVideo(const std::string& source, bool native, bool loopVideo) {
+    inputs.emplace_back(makeSource(source, native, loopVideo));
+}
+
+void VideoSources::openVideos(const std::vector<SourceDesc>& descs) {
+    // Opening a file or stream probes the container and may take long, so the sources are opened side by side
+    std::vector<std::future<std::unique_ptr<VideoSource>>> opened;
+    opened.reserve(descs.size());
+    for (auto& desc : descs) {
+        opened.emplace_back(std::async(std::launch::async, [this, &desc]() {
+            return makeSource(desc.source, desc.native, desc.loopVideo);
+        }));
+    }
+    std::exception_ptr error;
+    for (std::size_t i = 0; i < opened.size(); ++i) {
+        try {
+            inputs.emplace_back(opened[i].get());
+        } catch (const std::exception& e) {
+            if (!error) {
+                error = std::make_exception_ptr(std::runtime_error("Cannot open " + descs[i].source + ": " + e.what()));
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+std::unique_ptr<VideoSource> VideoSources::makeSource(const std::string& source, bool native, bool loopVideo) {
 #ifdef USE_NATIVE_CAMERA_API
     if (native) {
         std::string dev;
@@ -610,9 +974,9 @@ void VideoSources::openVideo(const std::string& source, bool native, bool loopVi
         camSettings.height = 480;
         camSettings.num_buffers = static_cast<unsigned>(queueSize);
 
-        std::unique_ptr<VideoSource> newSrc(new VideoSourceNative(*this, controller, dev, camSettings,
-                                                                     queueSize, realFps, collectStats));
-        inputs.emplace_back(std::move(newSrc));
+        std::lock_guard<std::mutex> lock(controllerMutex);
+        return std::unique_ptr<VideoSource>(new VideoSourceNative(*this, controller, dev, camSettings,
+                                                                  queueSize, realFps, collectStats));
     } else {
 #else
     {
@@ -621,18 +985,16 @@ void VideoSources::openVideo(const std::string& source, bool native, bool loopVi
         const std::string extension = ".mjpeg";
         std::unique_ptr<VideoSource> newSrc;
         if (source.size() > extension.size() && std::equal(extension.rbegin(), extension.rend(), source.rbegin()))
-            if (loopVideo)
-                throw std::runtime_error("Looping video is not supported for .mjpeg when built with USE_LIBVA");
-            newSrc.reset(new VideoSourceStreamFile(*this, isAsync, collectStats, source,
+            newSrc.reset(new VideoSourceStreamFile(*this, isAsync, collectStats, source, loopVideo,
                                             queueSize, pollingTimeMSec, realFps));
         else
-            newSrc.reset(new VideoSourceOCV(isAsync, collectStats, source, loopVideo,
-                                            queueSize, pollingTimeMSec, realFps));
+            newSrc.reset(new VideoSourceOCV(*this, isAsync, collectStats, source, loopVideo,
+                                            queueSize, pollingTimeMSec, realFps, latestFrame));
 #else
-        std::unique_ptr<VideoSource> newSrc(new VideoSourceOCV(isAsync, collectStats, source, loopVideo,
-                                            queueSize, pollingTimeMSec, realFps));
+        std::unique_ptr<VideoSource> newSrc(new VideoSourceOCV(*this, isAsync, collectStats, source, loopVideo,
+                                            queueSize, pollingTimeMSec, realFps, latestFrame));
 #endif
-        inputs.emplace_back(std::move(newSrc));
+        return newSrc;
     }
 }
 
@@ -643,12 +1005,50 @@ void VideoSources::start() {
 }
 
 bool VideoSources::getFrame(size_t index, VideoFrame& frame) {
+    return FrameStatus::Ready == getFrame(index, frame, FrameDeadline::max());
+}
+
+FrameStatus VideoSources::getFrame(size_t index, VideoFrame& frame, FrameDeadline deadline) {
     if (inputs.size() > 0) {
         if (index < inputs.size()) {
-            return inputs[index]->read(frame);
+            frame.captureTime = ReadyTime();
+            auto status = inputs[index]->read(frame, deadline);
+            if (ReadyTime() == frame.captureTime) {
+                frame.captureTime = std::chrono::steady_clock::now();  // the source keeps no capture time
+            }
+            return status;
         }
     }
-    return false;
+    return FrameStatus::Finished;
+}
+
+ReadyTime VideoSources::readySince(size_t index) const {
+    if (index < inputs.size()) {
+        return inputs[index]->readySince();
+    }
+    return ReadyTime();  // getFrame reports Finished right away
+}
+
+void VideoSources::notifyFrame() {
+    {
+        std::lock_guard<std::mutex> lock(arrivalMutex);
+        ++arrivals;
+    }
+    frameArrived.notify_all();
+}
+
+std::uint64_t VideoSources::frameArrivals() {
+    std::lock_guard<std::mutex> lock(arrivalMutex);
+    return arrivals;
+}
+
+bool VideoSources::waitForFrames(std::uint64_t& seenArrivals, FrameDeadline deadline) {
+    std::unique_lock<std::mutex> lock(arrivalMutex);
+    if (!waitForFrame(frameArrived, lock, deadline, [&]() { return arrivals != seenArrivals; })) {
+        return false;
+    }
+    seenArrivals = arrivals;
+    return true;
 }
 
 VideoSources::Stats VideoSources::getStats() const {
@@ -658,7 +1058,37 @@ VideoSources::Stats VideoSources::getStats() const {
         for (auto& input : inputs) {
             ret.readTimes.push_back(input->getAvgReadTime());
         }
-        ret.decodingLatency = decoder.getStats().decoding_latency;
+        ret.frameAges.reserve(inputs.size());
+        ret.droppedFrames.reserve(inputs.size());
+        for (auto& input : inputs) {
+            ret.frameAges.push_back(input->getFrameAge());
+            ret.droppedFrames.push_back(input->getDroppedFrames());
+        }
+        ret.motionSkipRates.reserve(inputs.size());
+        for (auto& input : inputs) {
+            ret.motionSkipRates.push_back(input->takeMotionSkipRate());
+        }
+        ret.decodingLatencies.reserve(inputs.size());
+        std::size_t decoding = 0;
+        for (auto& input : inputs) {
+            auto latency = input->getDecodingLatency();
+            ret.decodingLatencies.push_back(latency);
+            if (latency > 0.0f) {
+                ret.decodingLatency += latency;
+                ++decoding;
+            }
+        }
+        if (decoding > 0) {
+            ret.decodingLatency /= static_cast<float>(decoding);
+        }
+
+        auto poolStats = getFramePool().getStats();
+        auto frames = poolStats.buffers - lastPoolStats.buffers;
+        if (frames > 0) {
+            ret.bufferAllocationsPerFrame = static_cast<float>(poolStats.allocations - lastPoolStats.allocations) /
+                                            static_cast<float>(frames);
+            lastPoolStats = poolStats;
+        }
     }
     return ret;
 }
@@ -8,6 +8,8 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
@@ -20,6 +22,16 @@
 #endif
 
 #include "decoder.hpp"
+#include "frame_pool.hpp"
+
+enum class FrameStatus {
+    Ready,
+    NotReady,  // no frame arrived before the deadline
+    Finished
+};
+
+// Point in time after which a frame read gives up; max() waits indefinitely
+using FrameDeadline = std::chrono::steady_clock::time_point;
 
 class Detections {
 public:
@@ -29,6 +41,9 @@ public:
     template <typename T> void set(T* detections) {
         this->detections.reset(detections);
     }
+    template <typename T> void set(std::shared_ptr<T> detections) {
+        this->detections = std::move(detections);
+    }
 private:
     std::shared_ptr<void> detections;
 };
@@ -38,6 +53,12 @@ public:
     cv::Mat frame;
     std::size_t sourceIdx = 0;
     Detections detections;
+    // A frame the getter marks false is not inferred but handed out right away in read order
+    bool infer = true;
+    // When the source captured or decoded the frame; the read time for sources that do not record it
+    std::chrono::steady_clock::time_point captureTime;
+    // Read order among the frames of its source, set by IEGraph when sources keep their read order
+    std::uint64_t readSeq = 0;
     VideoFrame() = default;
 
     VideoFrame& operator =(VideoFrame const& vf) = delete;
@@ -50,22 +71,39 @@ class VideoSourceStreamFile;
 
 class VideoSources {
 private:
-    Decoder decoder;
+    // Every compressed source decodes with its own Decoder created from these settings
+    const Decoder::Settings decoderSettings;
 #ifdef USE_NATIVE_CAMERA_API
     mcam::controller controller;
 #endif
 
-    std::mutex decode_mutex;  // hardware decoding enqueue lock
-
     std::vector<std::unique_ptr<VideoSource>> inputs;
     const bool isAsync;
     const bool collectStats;
 
     bool realFps;
+    const bool mjpegIndexFile;
+    const bool latestFrame;
+    const bool lazyDecode;
+    const float motionThreshold;
 
     const size_t queueSize = 1;
     const size_t pollingTimeMSec = 1000;
 
+    mutable FramePool::Stats lastPoolStats;
+
+    // Bumped by every source whenever a read stops blocking
+    std::mutex arrivalMutex;
+    std::condition_variable frameArrived;
+    std::uint64_t arrivals = 0;
+
+    void notifyFrame();
+
+    std::unique_ptr<VideoSource> makeSource(const std::string& source, bool native, bool loopVideo);
+#ifdef USE_NATIVE_CAMERA_API
+    std::mutex controllerMutex;  // cameras are added to the controller one at a time
+#endif
+
     void stop();
 
     friend VideoSourceNative;
@@ -79,6 +117,16 @@ public:
         bool isAsync = true;
         bool collectStats = false;
         bool realFps = false;
+        // Keep the frame index of .mjpeg files in a <file>.idx sidecar between runs
+        bool mjpegIndexFile = false;
+        // Live cameras keep only their newest frame and drop older unread ones; files are unaffected
+        bool latestFrame = false;
+        // Compressed sources queue undecoded frames and decode only those that are read
+        bool lazyDecode = false;
+        // Compressed frames whose 8x8 block brightness changed by no more than this since the
+        // last frame let through are skipped before decoding; 0 lets every frame through
+        float motionThreshold = 0.0f;
+        // Network input size; compressed frames are decoded no larger than needed to cover it
         unsigned expectedWidth = 0;
         unsigned expectedHeight = 0;
     };
@@ -88,15 +136,38 @@ public:
 
     void openVideo(const std::string& source, bool native, bool loopVideo);
 
+    struct SourceDesc {
+        std::string source;
+        bool native = false;
+        bool loopVideo = false;
+    };
+    // Opens the sources side by side and adds them in the given order; the first failure is rethrown
+    void openVideos(const std::vector<SourceDesc>& descs);
+
     void start();
 
     virtual bool isRunning() const;
 
     bool getFrame(size_t index, VideoFrame& frame);
+    FrameStatus getFrame(size_t index, VideoFrame& frame, FrameDeadline deadline);
+
+    // Point in time since which getFrame(index) returns without blocking; max() while it would block
+    std::chrono::steady_clock::time_point readySince(size_t index) const;
+
+    std::uint64_t frameArrivals();
+    // Waits until a source got a frame after seenArrivals; returns false on deadline
+    bool waitForFrames(std::uint64_t& seenArrivals, FrameDeadline deadline);
 
     struct Stats {
         std::vector<float> readTimes;
-        float decodingLatency = 0.0f;
+        std::vector<float> decodingLatencies;  // per source, 0 for sources that do not decode themselves
+        float decodingLatency = 0.0f;          // average over the decoding sources
+        std::vector<float> frameAges;          // per source, capture to read
+        std::vector<std::uint64_t> droppedFrames;  // per source, total since start
+        std::vector<float> motionSkipRates;        // per source, share of frames skipped since the previous call
+        // Heap allocations made for frame buffers (not frame objects or queue nodes) per captured frame
+        // since the previous call
+        float bufferAllocationsPerFrame = 0.0f;
     };
 
     Stats getStats() const;
@@ -0,0 +1,422 @@
+#include "jpeg_dc.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+const int LookupBits = 9;
+
+struct HuffmanTable {
+    bool defined = false;
+    // Codes of up to LookupBits bits: (length << 8) | symbol, 0 if longer
+    std::array<std::uint16_t, 1 << LookupBits> lookup;
+    std::array<std::int32_t, 18> maxCode;  // largest code of each length, -1 if none
+    std::array<std::int32_t, 17> valPtr;   // index of the first symbol of each length
+    std::array<std::int32_t, 17> minCode;
+    std::array<std::uint8_t, 256> symbols;
+};
+
+struct Component {
+    int id = 0;
+    int h = 1;
+    int v = 1;
+    int quantTable = 0;
+    int dcTable = 0;
+    int acTable = 0;
+    int pred = 0;
+};
+
+// Standard tables of JPEG Annex K.3, which MJPEG cameras leave out of their frames (AVI1)
+const std::uint8_t DcLumaCounts[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+const std::uint8_t DcChromaCounts[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+const std::uint8_t DcSymbols[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+const std::uint8_t AcLumaCounts[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+const std::uint8_t AcLumaSymbols[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa};
+const std::uint8_t AcChromaCounts[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+const std::uint8_t AcChromaSymbols[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa};
+
+bool buildTable(const std::uint8_t* counts, const std::uint8_t* symbols, int total, HuffmanTable& table) {
+    // A table that fails part way must not be used by a later scan
+    table.defined = false;
+    std::copy(symbols, symbols + total, table.symbols.begin());
+    table.lookup.fill(0);
+    std::int32_t code = 0;
+    int k = 0;
+    for (int len = 1; len <= 16; ++len) {
+        // More codes than this length has would overrun the lookup table below
+        if (code + counts[len - 1] > (1 << len)) {
+            return false;
+        }
+        table.valPtr[len] = k;
+        table.minCode[len] = code;
+        for (int i = 0; i < counts[len - 1]; ++i, ++k, ++code) {
+            if (len <= LookupBits) {
+                int shift = LookupBits - len;
+                for (int fill = 0; fill < (1 << shift); ++fill) {
+                    table.lookup[(code << shift) | fill] = static_cast<std::uint16_t>((len << 8) | table.symbols[k]);
+                }
+            }
+        }
+        table.maxCode[len] = counts[len - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    table.maxCode[17] = 0x7fffffff;
+    table.defined = true;
+    return true;
+}
+
+struct StandardTables {
+    HuffmanTable dcLuma;
+    HuffmanTable dcChroma;
+    HuffmanTable acLuma;
+    HuffmanTable acChroma;
+};
+
+const StandardTables& standardTables() {
+    static const StandardTables tables = []() {
+        StandardTables t;
+        buildTable(DcLumaCounts, DcSymbols, 12, t.dcLuma);
+        buildTable(DcChromaCounts, DcSymbols, 12, t.dcChroma);
+        buildTable(AcLumaCounts, AcLumaSymbols, 162, t.acLuma);
+        buildTable(AcChromaCounts, AcChromaSymbols, 162, t.acChroma);
+        return t;
+    }();
+    return tables;
+}
+
+class BitReader {
+    const unsigned char* data;
+    const unsigned char* end;
+    std::uint32_t buffer = 0;
+    int bits = 0;
+    bool hitMarker = false;
+
+    void fill() {
+        while (bits <= 24) {
+            unsigned byte = 0;
+            if (!hitMarker && data < end) {
+                byte = *data;
+                if (0xFF == byte) {
+                    if (data + 1 < end && 0x00 == data[1]) {
+                        data += 2;
+                    } else {
+                        hitMarker = true;  // leave the marker for restart handling, feed zeros
+                        byte = 0;
+                    }
+                } else {
+                    ++data;
+                }
+            }
+            buffer |= static_cast<std::uint32_t>(byte) << (24 - bits);
+            bits += 8;
+        }
+    }
+
+public:
+    BitReader(const unsigned char* d, const unsigned char* e): data(d), end(e) {}
+
+    int getBits(int n) {
+        if (0 == n) {
+            return 0;
+        }
+        fill();
+        int value = static_cast<int>(buffer >> (32 - n));
+        buffer <<= n;
+        bits -= n;
+        return value;
+    }
+
+    int decode(const HuffmanTable& table) {
+        fill();
+        auto entry = table.lookup[buffer >> (32 - LookupBits)];
+        if (0 != entry) {
+            int len = entry >> 8;
+            buffer <<= len;
+            bits -= len;
+            return entry & 0xFF;
+        }
+        std::int32_t code = 0;
+        int len = 0;
+        do {
+            code = (code << 1) | getBits(1);
+            ++len;
+        } while (len <= 16 && code > table.maxCode[len]);
+        if (len > 16) {
+            return -1;
+        }
+        return table.symbols[(table.valPtr[len] + code - table.minCode[len]) & 0xFF];
+    }
+
+    // Skips to the next RSTn marker at a byte boundary
+    bool restart() {
+        buffer = 0;
+        bits = 0;
+        hitMarker = false;
+        while (data + 1 < end && !(0xFF == data[0] && data[1] >= 0xD0 && data[1] <= 0xD7)) {
+            ++data;
+        }
+        if (data + 1 >= end) {
+            return false;
+        }
+        data += 2;
+        return true;
+    }
+};
+
+int extend(int value, int bits) {
+    return value < (1 << (bits - 1)) ? value - (1 << bits) + 1 : value;
+}
+
+// Decodes one block, returns false on a corrupt code
+bool decodeBlock(BitReader& reader, const HuffmanTable& dc, const HuffmanTable& ac, int& pred) {
+    int s = reader.decode(dc);
+    if (s < 0 || s > 11) {
+        return false;
+    }
+    if (s > 0) {
+        pred += extend(reader.getBits(s), s);
+    }
+    for (int k = 1; k < 64; ++k) {
+        int rs = reader.decode(ac);
+        if (rs < 0) {
+            return false;
+        }
+        int r = rs >> 4;
+        s = rs & 15;
+        if (0 == s) {
+            if (15 != r) {
+                break;  // end of block
+            }
+            k += 15;
+        } else {
+            k += r;
+            reader.getBits(s);
+        }
+    }
+    return true;
+}
+}  // namespace
+
+bool decodeJpegDc(const unsigned char* data, std::size_t size, JpegDcThumbnail& thumbnail) {
+    std::array<HuffmanTable, 4> dcTables;
+    std::array<HuffmanTable, 4> acTables;
+    std::array<int, 4> quantDc = {{1, 1, 1, 1}};
+    std::vector<Component> components;
+    int width = 0;
+    int height = 0;
+    int restartInterval = 0;
+
+    // Frames without DHT segments use the standard tables; a DHT replaces them
+    const StandardTables& standard = standardTables();
+    dcTables[0] = standard.dcLuma;
+    dcTables[1] = standard.dcChroma;
+    acTables[0] = standard.acLuma;
+    acTables[1] = standard.acChroma;
+
+    const unsigned char* end = data + size;
+    const unsigned char* p = data;
+    if (size < 4 || 0xFF != p[0] || 0xD8 != p[1]) {
+        return false;
+    }
+    p += 2;
+    while (p + 4 <= end) {
+        if (0xFF != p[0]) {
+            return false;
+        }
+        const int marker = p[1];
+        if (0xFF == marker) {
+            ++p;
+            continue;
+        }
+        const int length = p[2] * 256 + p[3];
+        const unsigned char* segment = p + 4;
+        const unsigned char* segmentEnd = p + 2 + length;
+        if (length < 2 || segmentEnd > end) {
+            return false;
+        }
+        switch (marker) {
+        case 0xC0: {  // baseline SOF
+            if (length < 8) {
+                return false;
+            }
+            height = segment[1] * 256 + segment[2];
+            width = segment[3] * 256 + segment[4];
+            int count = segment[5];
+            if (0 == width || 0 == height || count < 1 || length < 8 + 3 * count) {
+                return false;
+            }
+            components.resize(count);
+            for (int i = 0; i < count; ++i) {
+                components[i].id = segment[6 + 3 * i];
+                components[i].h = segment[7 + 3 * i] >> 4;
+                components[i].v = segment[7 + 3 * i] & 15;
+                components[i].quantTable = segment[8 + 3 * i] & 3;
+                if (components[i].h < 1 || components[i].h > 4 || components[i].v < 1 || components[i].v > 4) {
+                    return false;
+                }
+            }
+            break;
+        }
+        case 0xC1: case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+        case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+            return false;  // not baseline Huffman
+        case 0xC4: {  // DHT
+            const unsigned char* q = segment;
+            while (q + 17 <= segmentEnd) {
+                int tableClass = q[0] >> 4;
+                int id = q[0] & 3;
+                int total = 0;
+                for (int i = 0; i < 16; ++i) {
+                    total += q[1 + i];
+                }
+                if (total > 256 || q + 17 + total > segmentEnd) {
+                    return false;
+                }
+                auto& table = tableClass ? acTables[id] : dcTables[id];
+                if (!buildTable(q + 1, q + 17, total, table)) {
+                    return false;
+                }
+                q += 17 + total;
+            }
+            break;
+        }
+        case 0xDB: {  // DQT, only the DC entry is needed
+            const unsigned char* q = segment;
+            while (q < segmentEnd) {
+                int precision = q[0] >> 4;
+                int id = q[0] & 3;
+                int tableSize = precision ? 128 : 64;
+                if (q + 1 + tableSize > segmentEnd) {
+                    return false;
+                }
+                quantDc[id] = precision ? q[1] * 256 + q[2] : q[1];
+                q += 1 + tableSize;
+            }
+            break;
+        }
+        case 0xDD:  // DRI
+            if (length < 4) {
+                return false;
+            }
+            restartInterval = segment[0] * 256 + segment[1];
+            break;
+        case 0xDA: {  // SOS, followed by the entropy-coded data
+            if (components.empty()) {
+                return false;
+            }
+            int count = segment[0];
+            if (count < 1 || count > static_cast<int>(components.size()) || length < 6 + 2 * count) {
+                return false;
+            }
+            std::vector<Component*> scan;
+            for (int i = 0; i < count; ++i) {
+                int id = segment[1 + 2 * i];
+                auto it = std::find_if(components.begin(), components.end(),
+                                       [id](const Component& c) { return c.id == id; });
+                if (it == components.end()) {
+                    return false;
+                }
+                it->dcTable = segment[2 + 2 * i] >> 4 & 3;
+                it->acTable = segment[2 + 2 * i] & 3;
+                if (!dcTables[it->dcTable].defined || !acTables[it->acTable].defined) {
+                    return false;
+                }
+                scan.push_back(&*it);
+            }
+            // Only the luma (first) component is kept
+            Component& luma = components[0];
+            int hMax = 1;
+            int vMax = 1;
+            for (auto& c : components) {
+                hMax = std::max(hMax, c.h);
+                vMax = std::max(vMax, c.v);
+            }
+            const int lumaWidth = (width * luma.h + hMax - 1) / hMax;
+            const int lumaHeight = (height * luma.v + vMax - 1) / vMax;
+            thumbnail.width = (lumaWidth + 7) / 8;
+            thumbnail.height = (lumaHeight + 7) / 8;
+            thumbnail.values.assign(static_cast<std::size_t>(thumbnail.width) * thumbnail.height, 0);
+            const int q0 = quantDc[luma.quantTable];
+            auto store = [&](int bx, int by, int pred) {
+                if (bx < thumbnail.width && by < thumbnail.height) {
+                    // The DC coefficient is 8 times the block mean of the level-shifted samples
+                    int value = pred * q0 / 8 + 128;
+                    thumbnail.values[by * thumbnail.width + bx] = static_cast<std::uint8_t>(std::min(255, std::max(0, value)));
+                }
+            };
+
+            BitReader reader(segmentEnd, end);
+            int mcusX = 0;
+            int mcusY = 0;
+            if (1 == count) {
+                // Non-interleaved scan: one block per MCU over the component's own size
+                const Component& c = *scan[0];
+                mcusX = ((width * c.h + hMax - 1) / hMax + 7) / 8;
+                mcusY = ((height * c.v + vMax - 1) / vMax + 7) / 8;
+            } else {
+                mcusX = (width + 8 * hMax - 1) / (8 * hMax);
+                mcusY = (height + 8 * vMax - 1) / (8 * vMax);
+            }
+            int untilRestart = restartInterval;
+            for (int my = 0; my < mcusY; ++my) {
+                for (int mx = 0; mx < mcusX; ++mx) {
+                    if (restartInterval > 0) {
+                        if (0 == untilRestart) {
+                            if (!reader.restart()) {
+                                return false;
+                            }
+                            for (auto& c : components) {
+                                c.pred = 0;
+                            }
+                            untilRestart = restartInterval;
+                        }
+                        --untilRestart;
+                    }
+                    for (auto* c : scan) {
+                        const int blocksH = 1 == count ? 1 : c->h;
+                        const int blocksV = 1 == count ? 1 : c->v;
+                        for (int by = 0; by < blocksV; ++by) {
+                            for (int bx = 0; bx < blocksH; ++bx) {
+                                if (!decodeBlock(reader, dcTables[c->dcTable], acTables[c->acTable], c->pred)) {
+                                    return false;
+                                }
+                                if (c == &luma) {
+                                    store(mx * blocksH + bx, my * blocksV + by, c->pred);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+        default:
+            break;
+        }
+        p = segmentEnd;
+    }
+    return false;
+}
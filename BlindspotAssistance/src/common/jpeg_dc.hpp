@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Luma DC plane of a JPEG image: the mean brightness (0..255) of every 8x8
+ * luma block, which is a 1/8 scale thumbnail of the frame.
+ */
+struct JpegDcThumbnail {
+    int width = 0;   // in blocks
+    int height = 0;
+    std::vector<std::uint8_t> values;  // row-major, width * height
+};
+
+/**
+ * Builds the DC thumbnail of a baseline (SOF0) JPEG by entropy decoding only:
+ * AC coefficients are Huffman-decoded and discarded, and neither
+ * dequantization of AC coefficients nor the IDCT is performed, which makes it
+ * several times cheaper than a full decode. Restart intervals and any chroma
+ * subsampling are supported, and frames without DHT segments, as MJPEG
+ * cameras send them, use the standard Huffman tables. Returns false for
+ * progressive, arithmetic-coded or malformed streams.
+ */
+bool decodeJpegDc(const unsigned char* data, std::size_t size, JpegDcThumbnail& thumbnail);
@@ -0,0 +1,134 @@
+#include "mjpeg_index.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+namespace {
+const unsigned char MarkerPrefix = 0xFF;
+const unsigned char SofMarker = 0xC0;  // baseline DCT
+const unsigned char SoiMarker = 0xD8;
+const unsigned char EoiMarker = 0xD9;
+const unsigned char RstFirstMarker = 0xD0;
+const unsigned char RstLastMarker = 0xD7;
+
+const char IndexMagic[8] = {'M', 'J', 'P', 'G', 'I', 'D', 'X', '1'};
+
+struct IndexHeader {
+    char magic[8];
+    std::uint64_t streamSize;
+    std::int64_t streamMtime;
+    std::uint64_t count;
+};
+
+struct IndexEntry {
+    std::uint64_t offset;
+    std::uint64_t length;
+    std::uint32_t width;
+    std::uint32_t height;
+};
+}  // namespace
+
+std::vector<MjpegFrameInfo> indexMjpegStream(const unsigned char* data, std::size_t size) {
+    std::vector<MjpegFrameInfo> frames;
+    MjpegFrameInfo current;
+    bool inFrame = false;
+    bool hasDims = false;
+    std::size_t pos = 0;
+    while (pos + 1 < size) {
+        auto found = static_cast<const unsigned char*>(std::memchr(data + pos, MarkerPrefix, size - pos - 1));
+        if (nullptr == found) {
+            break;
+        }
+        pos = static_cast<std::size_t>(found - data);
+        const unsigned char marker = data[pos + 1];
+        const bool restart = marker >= RstFirstMarker && marker <= RstLastMarker;
+        if (MarkerPrefix == marker) {
+            pos += 1;  // fill byte
+        } else if (SoiMarker == marker) {
+            current = MjpegFrameInfo();
+            current.offset = pos;
+            inFrame = true;
+            hasDims = false;
+            pos += 2;
+        } else if (EoiMarker == marker) {
+            if (inFrame && hasDims) {
+                current.length = pos + 2 - current.offset;
+                frames.push_back(current);
+            }
+            inFrame = false;
+            pos += 2;
+        } else if (0x00 == marker || 0x01 == marker || restart || !inFrame) {
+            // Stuffed byte or restart marker in entropy-coded data, or garbage between frames
+            pos += 2;
+        } else {
+            // Marker segment: skip it by its length instead of scanning its payload,
+            // which may even contain a complete thumbnail JPEG
+            if (pos + 4 > size) {
+                break;
+            }
+            const std::size_t segmentLength = data[pos + 2] * 256u + data[pos + 3];
+            if (SofMarker == marker && !hasDims && pos + 9 <= size) {
+                // FF C0, length (2), precision (1), height (2), width (2)
+                current.height = data[pos + 5] * 256u + data[pos + 6];
+                current.width = data[pos + 7] * 256u + data[pos + 8];
+                hasDims = true;
+            }
+            pos += 2 + segmentLength;
+        }
+    }
+    return frames;
+}
+
+bool loadMjpegIndex(const std::string& indexPath, std::uint64_t streamSize, std::int64_t streamMtime,
+                    std::vector<MjpegFrameInfo>& frames) {
+    std::ifstream file(indexPath, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    IndexHeader header = {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        0 != std::memcmp(header.magic, IndexMagic, sizeof(IndexMagic)) ||
+        header.streamSize != streamSize || header.streamMtime != streamMtime ||
+        header.count > streamSize / 4) {
+        return false;
+    }
+    std::vector<IndexEntry> entries(static_cast<std::size_t>(header.count));
+    if (!file.read(reinterpret_cast<char*>(entries.data()),
+                   static_cast<std::streamsize>(entries.size() * sizeof(IndexEntry)))) {
+        return false;
+    }
+    std::vector<MjpegFrameInfo> loaded;
+    loaded.reserve(entries.size());
+    for (auto& entry : entries) {
+        if (entry.offset > streamSize || entry.length > streamSize - entry.offset) {
+            return false;
+        }
+        MjpegFrameInfo info;
+        info.offset = static_cast<std::size_t>(entry.offset);
+        info.length = static_cast<std::size_t>(entry.length);
+        info.width = entry.width;
+        info.height = entry.height;
+        loaded.push_back(info);
+    }
+    frames = std::move(loaded);
+    return true;
+}
+
+void saveMjpegIndex(const std::string& indexPath, std::uint64_t streamSize, std::int64_t streamMtime,
+                    const std::vector<MjpegFrameInfo>& frames) {
+    std::ofstream file(indexPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return;
+    }
+    IndexHeader header = {};
+    std::memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+    header.streamSize = streamSize;
+    header.streamMtime = streamMtime;
+    header.count = frames.size();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (auto& frame : frames) {
+        IndexEntry entry = {frame.offset, frame.length, frame.width, frame.height};
+        file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct MjpegFrameInfo {
+    std::size_t offset = 0;  // first byte of the frame (SOI) in the stream
+    std::size_t length = 0;  // up to and including the EOI marker
+    unsigned width = 0;      // from the baseline SOF marker
+    unsigned height = 0;
+};
+
+/**
+ * Splits a concatenated MJPEG stream into frames in a single pass. Marker
+ * candidates are located with memchr, which the C library vectorizes, instead
+ * of comparing every byte. A trailing frame without an EOI marker or a frame
+ * without a baseline SOF marker is skipped.
+ */
+std::vector<MjpegFrameInfo> indexMjpegStream(const unsigned char* data, std::size_t size);
+
+/**
+ * Reads a frame index written by saveMjpegIndex. Returns false if the file is
+ * missing, corrupt or was made for a stream of a different size or mtime.
+ */
+bool loadMjpegIndex(const std::string& indexPath, std::uint64_t streamSize, std::int64_t streamMtime,
+                    std::vector<MjpegFrameInfo>& frames);
+
+// Best effort: a failure to write the index is not an error
+void saveMjpegIndex(const std::string& indexPath, std::uint64_t streamSize, std::int64_t streamMtime,
+                    const std::vector<MjpegFrameInfo>& frames);
@@ -0,0 +1,41 @@
+#include "motion_gate.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+MotionGate::MotionGate(float threshold): threshold(std::max(1, static_cast<int>(std::lround(threshold)))) {}
+
+bool MotionGate::changed(const unsigned char* jpeg, std::size_t size) {
+    if (!decodeJpegDc(jpeg, size, current)) {
+        passed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    bool moved = current.width != reference.width || current.height != reference.height;
+    if (!moved) {
+        // A single noisy block is not motion: require 0.1% of the blocks to change
+        const std::size_t needed = std::max<std::size_t>(1, current.values.size() / 1000);
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < current.values.size() && count < needed; ++i) {
+            if (std::abs(current.values[i] - reference.values[i]) > threshold) {
+                ++count;
+            }
+        }
+        moved = count >= needed;
+    }
+    if (moved) {
+        // Compare against the last frame let through, so a slow drift adds up and is not missed
+        std::swap(reference, current);
+        passed.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        skipped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return moved;
+}
+
+float MotionGate::takeSkipRate() {
+    const std::uint32_t s = skipped.exchange(0, std::memory_order_relaxed);
+    const std::uint32_t p = passed.exchange(0, std::memory_order_relaxed);
+    return 0 == s + p ? 0.0f : static_cast<float>(s) / (s + p);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "jpeg_dc.hpp"
+
+/**
+ * Decides from the DC thumbnail of a JPEG frame whether the scene changed
+ * since the last frame it let through. Frames the gate rejects need neither a
+ * full decode nor inference. Not thread safe except for takeSkipRate().
+ */
+class MotionGate {
+public:
+    // threshold: mean brightness change (0..255) of an 8x8 block that counts as motion
+    explicit MotionGate(float threshold);
+
+    // Returns true if the frame differs from the reference or cannot be analysed
+    bool changed(const unsigned char* jpeg, std::size_t size);
+
+    // Share of frames skipped since the previous call
+    float takeSkipRate();
+
+private:
+    const int threshold;
+    JpegDcThumbnail reference;
+    JpegDcThumbnail current;
+    std::atomic<std::uint32_t> passed{0};
+    std::atomic<std::uint32_t> skipped{0};
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/**
+ * Bounded lock-free multi-producer multi-consumer queue (D. Vyukov's design).
+ * Every cell carries a sequence number which tells producers and consumers
+ * whether the cell is free or holds a value for the current lap, so a push or
+ * a pop is a single CAS on the shared position plus a release store to the
+ * cell. Never allocates after construction: tryPush fails only when the ring
+ * is full and tryPop only when it is empty; a cell that another thread has
+ * claimed but not finished with is waited for instead of being reported as
+ * full or empty.
+ */
+template<typename T>
+class MpmcRing final {
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    static constexpr std::size_t CacheLineSize = 64;
+
+    const std::size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    // Producers and consumers update different cache lines
+    char padding0[CacheLineSize];
+    std::atomic<std::size_t> enqueuePos = {0};
+    char padding1[CacheLineSize - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> dequeuePos = {0};
+
+    static std::size_t roundUpPow2(std::size_t n) {
+        std::size_t ret = 1;
+        while (ret < n) {
+            ret <<= 1;
+        }
+        return ret;
+    }
+
+public:
+    // The capacity is rounded up to a power of two
+    explicit MpmcRing(std::size_t minCapacity):
+        mask(roundUpPow2(minCapacity < 2 ? 2 : minCapacity) - 1),
+        cells(new Cell[mask + 1]) {
+        for (std::size_t i = 0; i <= mask; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator =(const MpmcRing&) = delete;
+
+    std::size_t capacity() const {
+        return mask + 1;
+    }
+
+    template<typename U>
+    bool tryPush(U&& value) {
+        Cell* cell;
+        auto pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[pos & mask];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (0 == diff) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                if (dequeuePos.load(std::memory_order_relaxed) + mask + 1 == pos) {
+                    return false;  // full
+                }
+                // A consumer has claimed the cell but has not released it yet
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::forward<U>(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        Cell* cell;
+        auto pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[pos & mask];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (0 == diff) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                if (enqueuePos.load(std::memory_order_relaxed) == pos) {
+                    return false;  // empty
+                }
+                // A producer has claimed the cell but has not published it yet
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when other threads are pushing or popping concurrently
+    std::size_t size() const {
+        auto tail = enqueuePos.load(std::memory_order_acquire);
+        auto head = dequeuePos.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const {
+        return 0 == size();
+    }
+};
@@ -37,6 +37,47 @@ static const char show_calibration_message[] = "Optional. Show camera calibratio
 static const char alerts_message[] = "Optional. Send alerts to AlertManager.";
 static const char driver_mode[] = "Optional. Force a specific driver mode.";
 static const char eis_msg_bus[] = "Optional. Define IES Message Bus configuration.";
+static const char ie_preprocessing_message[] = "Optional. Pass decoded frames to the Inference Engine as U8 NHWC blobs "
+                                               "and let it resize them instead of converting them on the CPU. Requires -bs 1.";
+static const char async_completion_message[] = "Optional. Collect infer requests through completion callbacks as they finish "
+                                               "instead of waiting for the oldest one.";
+static const char ordered_results_message[] = "Optional. With -async_completion, still display the frames of every camera in capture order.";
+static const char producers_message[] = "Optional. Number of threads preparing and submitting batches. "
+                                        "Each one serves its own cameras and infer requests.";
+static const char batch_deadline_message[] = "Optional. Start a partially filled batch once its first frame has waited "
+                                             "this many milliseconds. 0 always waits for a full batch.";
+static const char dynamic_batch_message[] = "Optional. Infer partial batches with the plugin's dynamic batching instead of padding them.";
+static const char mode_budgets_message[] = "Optional. Share the inference among the cameras by driving mode: prefer the rear "
+                                           "camera in Reverse and the side cameras on the highway, and limit the frame rate "
+                                           "of the others in Reverse, Parking and Surveillance.";
+static const char rear_camera_message[] = "Optional. With -mode_budgets, number of the rear camera (1-based), whose frames are "
+                                          "inferred preferentially in Reverse mode. 0 disables it.";
+static const char cache_dir_message[] = "Optional. Directory where the compiled network is saved and loaded from on later "
+                                        "starts, if the device supports it. A changed model or setting compiles it again.";
+static const char side_cameras_message[] = "Optional. With -mode_budgets, comma separated numbers of the side cameras (1-based), whose frames "
+                                           "are inferred preferentially on the highway.";
+static const char parking_fps_message[] = "Optional. With -mode_budgets, frames per second inferred from every camera in Parking mode. "
+                                          "0 removes the limit.";
+static const char latest_frame_message[] = "Optional. Let cameras keep only their newest frame and drop older unread ones, "
+                                           "so inference always sees the freshest image. Video files are read as usual.";
+static const char lazy_decode_message[] = "Optional. Keep camera and .mjpeg frames compressed until inference takes them, "
+                                          "so frames that are dropped are never decoded.";
+static const char motion_threshold_message[] = "Optional. Skip decoding and inferring MJPEG camera and .mjpeg frames whose "
+                                               "8x8 block brightness changed by no more than this (0-255) since the last "
+                                               "inferred frame. 0 disables motion gating.";
+static const char cpu_streams_message[] = "Optional. Number of CPU throughput streams, each inferring one request at a time, "
+                                          "or \"auto\" to derive it from -nireq and the number of physical cores. "
+                                          "Not set leaves it to the plugin.";
+static const char cpu_threads_message[] = "Optional. Number of CPU inference threads. 0 lets the plugin decide.";
+static const char cpu_bind_message[] = "Optional. CPU inference thread binding: NO, YES (to cores) or NUMA (to NUMA nodes).";
+static const char autotune_message[] = "Optional. Run the pipeline headless with a series of -bs, -nireq, -n_iqs and "
+                                       "-nstreams values, searching for the highest throughput, and write the configurations "
+                                       "that are best in throughput or p99 latency to -autotune_out. Each run lasts -n_sp "
+                                       "sampling periods; the first one is not measured.";
+static const char autotune_out_message[] = "Optional. JSON file the -autotune configurations and their flags are written to.";
+static const char tune_report_message[] = "Optional. Used by -autotune: write the throughput and p99 latency to this file at exit.";
+static const char mjpeg_index_message[] = "Optional. Save the frame index of .mjpeg inputs next to them as <file>.idx "
+                                          "and reuse it on later runs.";
 
 DEFINE_bool(h, false, help_message);
 DEFINE_string(m, "", model_path_message);
@@ -63,3 +104,24 @@ DEFINE_bool(show_calibration, false, show_calibration_message);
 DEFINE_bool(alerts, false, alerts_message);
 DEFINE_string(dm, "", driver_mode);
 DEFINE_string(msg_bus, "", eis_msg_bus);
+DEFINE_bool(ie_preproc, false, ie_preprocessing_message);
+DEFINE_bool(async_completion, false, async_completion_message);
+DEFINE_bool(ordered, false, ordered_results_message);
+DEFINE_uint32(producers, 1, producers_message);
+DEFINE_uint32(batch_deadline_ms, 0, batch_deadline_message);
+DEFINE_bool(dyn_batch, false, dynamic_batch_message);
+DEFINE_bool(mode_budgets, false, mode_budgets_message);
+DEFINE_uint32(rear_cam, 0, rear_camera_message);
+DEFINE_string(side_cams, "", side_cameras_message);
+DEFINE_string(cache_dir, "", cache_dir_message);
+DEFINE_double(parking_fps, 2.0, parking_fps_message);
+DEFINE_bool(mjpeg_index, false, mjpeg_index_message);
+DEFINE_bool(latest_frame, false, latest_frame_message);
+DEFINE_bool(lazy_decode, false, lazy_decode_message);
+DEFINE_double(motion_threshold, 0.0, motion_threshold_message);
+DEFINE_string(nstreams, "", cpu_streams_message);
+DEFINE_uint32(nthreads, 0, cpu_threads_message);
+DEFINE_string(pin, "NO", cpu_bind_message);
+DEFINE_bool(autotune, false, autotune_message);
+DEFINE_string(autotune_out, "autotune.json", autotune_out_message);
+DEFINE_string(tune_report, "", tune_report_message);
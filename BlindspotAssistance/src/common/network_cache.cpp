@@ -0,0 +1,158 @@
+#include "network_cache.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <inference_engine.hpp>
+
+namespace {
+const char BlobExtension[] = ".blob";
+const std::size_t KeyLength = 16;  // hex digits of each of the model and the config key
+
+// FNV-1a over 8 byte words, enough to tell model revisions apart
+class Hasher {
+    std::uint64_t state = 14695981039346656037ull;
+
+public:
+    void add(const void* data, std::size_t size) {
+        auto bytes = static_cast<const unsigned char*>(data);
+        std::size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            state = (state ^ word) * 1099511628211ull;
+        }
+        for (; i < size; ++i) {
+            state = (state ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    void add(const std::string& text) {
+        add(text.data(), text.size());
+        add("\0", 1);  // keeps "ab", "c" apart from "a", "bc"
+    }
+
+    void addFile(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Cannot read " + path);
+        }
+        std::vector<char> buffer(1 << 20);
+        while (file) {
+            file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            add(buffer.data(), static_cast<std::size_t>(file.gcount()));
+        }
+    }
+
+    std::uint64_t value() const {
+        return state;
+    }
+};
+
+std::string hexKey(std::uint64_t value) {
+    std::ostringstream key;
+    key << std::hex << std::setw(KeyLength) << std::setfill('0') << value;
+    return key.str();
+}
+
+// mkdir -p
+void makeDirectories(const std::string& path) {
+    for (std::size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        const std::string dir = path.substr(0, slash);
+        struct stat sb;
+        if (!dir.empty() && 0 != mkdir(dir.c_str(), 0755) && (0 != stat(dir.c_str(), &sb) || !S_ISDIR(sb.st_mode))) {
+            throw std::runtime_error("Cannot create directory " + dir);
+        }
+        if (std::string::npos == slash) {
+            break;
+        }
+    }
+}
+
+std::string baseName(const std::string& path) {
+    auto slash = path.find_last_of("/\\");
+    auto name = std::string::npos == slash ? path : path.substr(slash + 1);
+    auto dot = name.find_last_of('.');
+    return std::string::npos == dot ? name : name.substr(0, dot);
+}
+}  // namespace
+
+CompiledNetworkCache::CompiledNetworkCache(const std::string& dir, const std::string& modelPath,
+                                           const std::string& deviceName, std::size_t batchSize,
+                                           const std::map<std::string, std::string>& config):
+    cacheDir(dir) {
+    Hasher modelHasher;
+    modelHasher.addFile(modelPath);
+    auto dot = modelPath.find_last_of('.');
+    modelHasher.addFile((std::string::npos == dot ? modelPath : modelPath.substr(0, dot)) + ".bin");
+    // A new plugin build may not import blobs of an old one
+    modelHasher.add(InferenceEngine::GetInferenceEngineVersion()->buildNumber);
+
+    Hasher configHasher;
+    configHasher.add(deviceName);
+    configHasher.add(std::to_string(batchSize));
+    for (auto& entry : config) {  // std::map iterates in key order
+        configHasher.add(entry.first);
+        configHasher.add(entry.second);
+    }
+
+    prefix = baseName(modelPath) + "-";
+    modelKey = hexKey(modelHasher.value());
+    blobPath = cacheDir + "/" + prefix + modelKey + "-" + hexKey(configHasher.value()) + BlobExtension;
+}
+
+bool CompiledNetworkCache::exists() const {
+    struct stat sb;
+    return 0 == stat(blobPath.c_str(), &sb) && S_ISREG(sb.st_mode);
+}
+
+void CompiledNetworkCache::store(const std::function<void(const std::string& path)>& write) const {
+    // Unique per process, and not named like a blob, so pruneStale() leaves it alone
+    const std::string tempPath = blobPath + "." + std::to_string(getpid()) + ".tmp";
+    makeDirectories(cacheDir);
+    try {
+        write(tempPath);
+    } catch (...) {
+        std::remove(tempPath.c_str());
+        throw;
+    }
+    if (0 != std::rename(tempPath.c_str(), blobPath.c_str())) {
+        std::remove(tempPath.c_str());
+        throw std::runtime_error("Cannot rename " + tempPath + " to " + blobPath);
+    }
+}
+
+void CompiledNetworkCache::discard() const {
+    std::remove(blobPath.c_str());
+}
+
+void CompiledNetworkCache::pruneStale() const {
+    DIR* dir = opendir(cacheDir.c_str());
+    if (nullptr == dir) {
+        return;
+    }
+    const std::size_t extensionSize = sizeof(BlobExtension) - 1;
+    while (dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        // The exact length keeps "model-v2-<keys>" from matching the prefix of "model".
+        // Blobs of the same model files with other devices or settings are kept for a later switch.
+        if (name.size() == prefix.size() + 2 * KeyLength + 1 + extensionSize &&
+            0 == name.compare(0, prefix.size(), prefix) &&
+            0 != name.compare(prefix.size(), KeyLength, modelKey) &&
+            '-' == name[prefix.size() + KeyLength] &&
+            0 == name.compare(name.size() - extensionSize, extensionSize, BlobExtension)) {
+            std::remove((cacheDir + "/" + name).c_str());
+        }
+    }
+    closedir(dir);
+}
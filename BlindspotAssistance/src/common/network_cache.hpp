@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+
+/**
+ * Location of compiled networks exported by the Inference Engine. A compiled
+ * network is stored as <cacheDir>/<model>-<model key>-<config key>.blob. The
+ * model key hashes the model files and the Inference Engine build, the config
+ * key the device, the batch size and the load configuration. Changing any of
+ * them changes the file name, so a stale blob is never imported.
+ */
+class CompiledNetworkCache {
+public:
+    CompiledNetworkCache(const std::string& cacheDir, const std::string& modelPath, const std::string& deviceName,
+                         std::size_t batchSize, const std::map<std::string, std::string>& config);
+
+    const std::string& path() const {
+        return blobPath;
+    }
+
+    bool exists() const;
+
+    /**
+     * Creates the cache directory if needed, has write() save the blob to a temporary file
+     * next to it and renames that into place, so a concurrent start or an interrupted export
+     * never sees a partial blob. Rethrows what write() throws after deleting the temporary file.
+     */
+    void store(const std::function<void(const std::string& path)>& write) const;
+
+    // Deletes the blob, e.g. one the plugin failed to import
+    void discard() const;
+
+    // Deletes the blobs of older model files or Inference Engine builds; other configs stay
+    void pruneStale() const;
+
+private:
+    std::string cacheDir;
+    std::string prefix;  // <model>-
+    std::string modelKey;
+    std::string blobPath;
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "mpmc_ring.hpp"
+
+struct ObjectPoolStats {
+    std::uint64_t acquired = 0;     // objects handed out
+    std::uint64_t allocations = 0;  // heap allocations made to serve them
+};
+
+/**
+ * Lock-free pool of reusable objects handed out as std::shared_ptr.
+ * When the last reference goes away the object is reset and returned to the
+ * pool instead of being deleted. The shared_ptr control blocks are recycled
+ * as well, so once the pool holds enough objects to cover everything in
+ * flight, acquire() and release do not touch the heap. Objects and blocks
+ * that do not fit into the pool when released are freed.
+ * Released objects keep the pool state alive, so they may outlive the pool.
+ */
+template<typename T>
+class ObjectPool final {
+    static constexpr std::size_t ControlBlockSize = 128;
+
+    struct alignas(std::max_align_t) ControlBlock {
+        unsigned char storage[ControlBlockSize];
+    };
+
+    struct State {
+        MpmcRing<T*> objects;
+        MpmcRing<ControlBlock*> blocks;
+        std::function<void(T&)> reset;
+        std::atomic<std::uint64_t> acquired = {0};
+        std::atomic<std::uint64_t> allocations = {0};
+
+        State(std::size_t capacity, std::function<void(T&)> r):
+            objects(capacity), blocks(capacity), reset(std::move(r)) {}
+
+        ~State() {
+            T* obj = nullptr;
+            while (objects.tryPop(obj)) {
+                delete obj;
+            }
+            ControlBlock* block = nullptr;
+            while (blocks.tryPop(block)) {
+                delete block;
+            }
+        }
+    };
+
+    // Allocator for shared_ptr control blocks
+    template<typename U>
+    struct BlockAllocator {
+        using value_type = U;
+
+        std::shared_ptr<State> state;
+
+        explicit BlockAllocator(std::shared_ptr<State> s): state(std::move(s)) {}
+        template<typename V>
+        BlockAllocator(const BlockAllocator<V>& other): state(other.state) {}
+
+        U* allocate(std::size_t n) {
+            static_assert(alignof(U) <= alignof(ControlBlock), "Unexpected control block alignment");
+            if (n * sizeof(U) > sizeof(ControlBlock)) {
+                ++state->allocations;
+                return static_cast<U*>(::operator new(n * sizeof(U)));
+            }
+            ControlBlock* block = nullptr;
+            if (!state->blocks.tryPop(block)) {
+                ++state->allocations;
+                block = new ControlBlock;
+            }
+            return reinterpret_cast<U*>(block);
+        }
+
+        void deallocate(U* p, std::size_t n) {
+            if (n * sizeof(U) > sizeof(ControlBlock)) {
+                ::operator delete(p);
+                return;
+            }
+            auto block = reinterpret_cast<ControlBlock*>(p);
+            if (!state->blocks.tryPush(block)) {
+                delete block;
+            }
+        }
+
+        template<typename V>
+        bool operator ==(const BlockAllocator<V>& other) const {
+            return state == other.state;
+        }
+        template<typename V>
+        bool operator !=(const BlockAllocator<V>& other) const {
+            return state != other.state;
+        }
+    };
+
+    struct Recycler {
+        std::shared_ptr<State> state;
+
+        void operator()(T* obj) const {
+            if (state->reset) {
+                state->reset(*obj);
+            }
+            if (!state->objects.tryPush(obj)) {
+                delete obj;
+            }
+        }
+    };
+
+    std::shared_ptr<State> state;
+
+public:
+    /**
+     * @param capacity - number of free objects (and control blocks) kept for reuse
+     * @param reset - applied to an object when it is returned to the pool
+     */
+    explicit ObjectPool(std::size_t capacity, std::function<void(T&)> reset = nullptr):
+        state(std::make_shared<State>(capacity, std::move(reset))) {}
+
+    std::shared_ptr<T> acquire() {
+        ++state->acquired;
+        T* obj = nullptr;
+        if (!state->objects.tryPop(obj)) {
+            ++state->allocations;
+            obj = new T();
+        }
+        return std::shared_ptr<T>(obj, Recycler{state}, BlockAllocator<T>(state));
+    }
+
+    ObjectPoolStats getStats() const {
+        ObjectPoolStats ret;
+        ret.acquired = state->acquired;
+        ret.allocations = state->allocations;
+        return ret;
+    }
+};
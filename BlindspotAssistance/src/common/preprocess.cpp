@@ -0,0 +1,299 @@
+#include "preprocess.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PREPROCESS_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using RowFunc = void (*)(const uint8_t* src, int width, float* dst0, float* dst1, float* dst2);
+
+struct RowKernel {
+    RowFunc func;
+    const char* isa;
+};
+
+void hwcRowToPlanarScalar(const uint8_t* src, int width, float* dst0, float* dst1, float* dst2) {
+    for (int x = 0; x < width; x++) {
+        dst0[x] = static_cast<float>(src[3 * x + 0]);
+        dst1[x] = static_cast<float>(src[3 * x + 1]);
+        dst2[x] = static_cast<float>(src[3 * x + 2]);
+    }
+}
+
+#ifdef PREPROCESS_X86_DISPATCH
+
+// Splits 16 interleaved pixels (48 bytes) into one 16-byte vector per channel
+__attribute__((target("sse4.1")))
+inline void deinterleave16(const uint8_t* src, __m128i& ch0, __m128i& ch1, __m128i& ch2) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+
+    const __m128i m0a = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i m0b = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    const __m128i m0c = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+    const __m128i m1a = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i m1b = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+    const __m128i m1c = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+    const __m128i m2a = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i m2b = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i m2c = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+
+    ch0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m0a), _mm_shuffle_epi8(b, m0b)), _mm_shuffle_epi8(c, m0c));
+    ch1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m1a), _mm_shuffle_epi8(b, m1b)), _mm_shuffle_epi8(c, m1c));
+    ch2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m2a), _mm_shuffle_epi8(b, m2b)), _mm_shuffle_epi8(c, m2c));
+}
+
+__attribute__((target("sse4.1")))
+inline void store16Sse41(__m128i v, float* dst) {
+    _mm_storeu_ps(dst + 0,  _mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)));
+    _mm_storeu_ps(dst + 4,  _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4))));
+    _mm_storeu_ps(dst + 8,  _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8))));
+    _mm_storeu_ps(dst + 12, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12))));
+}
+
+__attribute__((target("avx2")))
+inline void store16Avx2(__m128i v, float* dst) {
+    _mm256_storeu_ps(dst + 0, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)));
+    _mm256_storeu_ps(dst + 8, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8))));
+}
+
+__attribute__((target("avx512f")))
+inline void store16Avx512(__m128i v, float* dst) {
+    // the zero-masked forms avoid gcc's false -Wmaybe-uninitialized on the unmasked intrinsics
+    const __mmask16 all = 0xFFFF;
+    _mm512_storeu_ps(dst, _mm512_maskz_cvtepi32_ps(all, _mm512_maskz_cvtepu8_epi32(all, v)));
+}
+
+__attribute__((target("sse4.1")))
+void hwcRowToPlanarSse41(const uint8_t* src, int width, float* dst0, float* dst1, float* dst2) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i ch0, ch1, ch2;
+        deinterleave16(src + 3 * x, ch0, ch1, ch2);
+        store16Sse41(ch0, dst0 + x);
+        store16Sse41(ch1, dst1 + x);
+        store16Sse41(ch2, dst2 + x);
+    }
+    hwcRowToPlanarScalar(src + 3 * x, width - x, dst0 + x, dst1 + x, dst2 + x);
+}
+
+__attribute__((target("avx2")))
+void hwcRowToPlanarAvx2(const uint8_t* src, int width, float* dst0, float* dst1, float* dst2) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i ch0, ch1, ch2;
+        deinterleave16(src + 3 * x, ch0, ch1, ch2);
+        store16Avx2(ch0, dst0 + x);
+        store16Avx2(ch1, dst1 + x);
+        store16Avx2(ch2, dst2 + x);
+    }
+    hwcRowToPlanarScalar(src + 3 * x, width - x, dst0 + x, dst1 + x, dst2 + x);
+}
+
+__attribute__((target("avx512f")))
+void hwcRowToPlanarAvx512(const uint8_t* src, int width, float* dst0, float* dst1, float* dst2) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i ch0, ch1, ch2;
+        deinterleave16(src + 3 * x, ch0, ch1, ch2);
+        store16Avx512(ch0, dst0 + x);
+        store16Avx512(ch1, dst1 + x);
+        store16Avx512(ch2, dst2 + x);
+    }
+    hwcRowToPlanarScalar(src + 3 * x, width - x, dst0 + x, dst1 + x, dst2 + x);
+}
+
+#endif  // PREPROCESS_X86_DISPATCH
+
+// Kernels that run on this CPU, best first; the scalar one is always last
+std::vector<RowKernel> supportedRowKernels() {
+    std::vector<RowKernel> kernels;
+#ifdef PREPROCESS_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        kernels.push_back({hwcRowToPlanarAvx512, "AVX-512"});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({hwcRowToPlanarAvx2, "AVX2"});
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        kernels.push_back({hwcRowToPlanarSse41, "SSE4.1"});
+    }
+#endif
+    kernels.push_back({hwcRowToPlanarScalar, "scalar"});
+    return kernels;
+}
+
+const std::vector<RowKernel>& rowKernels() {
+    static const std::vector<RowKernel> kernels = supportedRowKernels();
+    return kernels;
+}
+
+const RowKernel& rowKernel() {
+    return rowKernels().front();
+}
+
+void hwcToPlanarRows(RowFunc func, const uint8_t* src, std::size_t srcStep, int width, int height, float* dst) {
+    const std::size_t planeSize = static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+    float* dst0 = dst;
+    float* dst1 = dst + planeSize;
+    float* dst2 = dst + 2 * planeSize;
+    for (int y = 0; y < height; y++) {
+        const std::size_t offset = static_cast<std::size_t>(y) * static_cast<std::size_t>(width);
+        func(src + y * srcStep, width, dst0 + offset, dst1 + offset, dst2 + offset);
+    }
+}
+
+// Source offsets and weights of the two neighbours of every output coordinate
+struct LinearTable {
+    std::vector<int> ofs0;
+    std::vector<int> ofs1;
+    std::vector<float> alpha;
+
+    void build(int srcLen, int dstLen, int stride) {
+        ofs0.resize(static_cast<std::size_t>(dstLen));
+        ofs1.resize(static_cast<std::size_t>(dstLen));
+        alpha.resize(static_cast<std::size_t>(dstLen));
+        const float scale = static_cast<float>(srcLen) / static_cast<float>(dstLen);
+        for (int d = 0; d < dstLen; d++) {
+            const float pos = (static_cast<float>(d) + 0.5f) * scale - 0.5f;
+            int i0 = static_cast<int>(std::floor(pos));
+            float a = pos - static_cast<float>(i0);
+            if (i0 < 0) {
+                i0 = 0;
+                a = 0.0f;
+            }
+            if (i0 >= srcLen - 1) {
+                i0 = srcLen - 1;
+                a = 0.0f;
+            }
+            const int i1 = std::min(i0 + 1, srcLen - 1);
+            const auto idx = static_cast<std::size_t>(d);
+            ofs0[idx] = i0 * stride;
+            ofs1[idx] = i1 * stride;
+            alpha[idx] = a;
+        }
+    }
+};
+
+// Per-thread tables and horizontally resampled rows, reused between frames
+struct ResizeScratch {
+    LinearTable xTable;
+    LinearTable yTable;
+    std::vector<float> rows[2];
+};
+
+void resampleRow(const uint8_t* src, const LinearTable& xTable, int dstWidth, float* row) {
+    float* row0 = row;
+    float* row1 = row + dstWidth;
+    float* row2 = row + 2 * dstWidth;
+    for (int x = 0; x < dstWidth; x++) {
+        const auto idx = static_cast<std::size_t>(x);
+        const uint8_t* p0 = src + xTable.ofs0[idx];
+        const uint8_t* p1 = src + xTable.ofs1[idx];
+        const float a = xTable.alpha[idx];
+        row0[x] = p0[0] + a * static_cast<float>(p1[0] - p0[0]);
+        row1[x] = p0[1] + a * static_cast<float>(p1[1] - p0[1]);
+        row2[x] = p0[2] + a * static_cast<float>(p1[2] - p0[2]);
+    }
+}
+
+void blendRows(const float* top, const float* bottom, float a, int count, float* dst) {
+    for (int x = 0; x < count; x++) {
+        dst[x] = top[x] + a * (bottom[x] - top[x]);
+    }
+}
+
+}  // namespace
+
+void hwcToPlanar(const uint8_t* src, std::size_t srcStep, int width, int height, float* dst) {
+    assert(nullptr != src);
+    assert(nullptr != dst);
+    hwcToPlanarRows(rowKernel().func, src, srcStep, width, height, dst);
+}
+
+bool hwcToPlanar(const cv::Mat& img, float* dst, const std::string& isa) {
+    assert(CV_8UC3 == img.type());
+    assert(nullptr != dst);
+    for (auto& kernel : rowKernels()) {
+        if (isa == kernel.isa) {
+            hwcToPlanarRows(kernel.func, img.data, img.step, img.cols, img.rows, dst);
+            return true;
+        }
+    }
+    return false;
+}
+
+void hwcToPlanar(const cv::Mat& img, float* dst) {
+    assert(CV_8UC3 == img.type());
+    hwcToPlanar(img.data, img.step, img.cols, img.rows, dst);
+}
+
+const char* hwcToPlanarIsa() {
+    return rowKernel().isa;
+}
+
+std::vector<std::string> hwcToPlanarIsas() {
+    std::vector<std::string> isas;
+    for (auto& kernel : rowKernels()) {
+        isas.push_back(kernel.isa);
+    }
+    return isas;
+}
+
+void resizeToPlanar(const cv::Mat& src, cv::Size dstSize, float* dst) {
+    assert(CV_8UC3 == src.type());
+    assert(nullptr != dst);
+    if (src.size() == dstSize) {
+        hwcToPlanar(src, dst);
+        return;
+    }
+
+    const int dstWidth = dstSize.width;
+    const int dstHeight = dstSize.height;
+    const std::size_t planeSize = static_cast<std::size_t>(dstWidth) * static_cast<std::size_t>(dstHeight);
+
+    thread_local ResizeScratch scratch;
+    scratch.xTable.build(src.cols, dstWidth, 3);
+    scratch.yTable.build(src.rows, dstHeight, 1);
+    for (auto& row : scratch.rows) {
+        row.resize(3 * static_cast<std::size_t>(dstWidth));
+    }
+
+    // Source rows currently held in scratch.rows[0] and scratch.rows[1]
+    int cached[2] = {-1, -1};
+    for (int y = 0; y < dstHeight; y++) {
+        const auto idx = static_cast<std::size_t>(y);
+        const int sy0 = scratch.yTable.ofs0[idx];
+        const int sy1 = scratch.yTable.ofs1[idx];
+        if (cached[0] != sy0) {
+            if (cached[1] == sy0) {
+                std::swap(scratch.rows[0], scratch.rows[1]);
+                std::swap(cached[0], cached[1]);
+            } else {
+                resampleRow(src.ptr<uint8_t>(sy0), scratch.xTable, dstWidth, scratch.rows[0].data());
+                cached[0] = sy0;
+            }
+        }
+        if (cached[1] != sy1) {
+            resampleRow(src.ptr<uint8_t>(sy1), scratch.xTable, dstWidth, scratch.rows[1].data());
+            cached[1] = sy1;
+        }
+
+        const float a = scratch.yTable.alpha[idx];
+        const std::size_t dstOffset = idx * static_cast<std::size_t>(dstWidth);
+        for (int c = 0; c < 3; c++) {
+            const std::size_t rowOffset = static_cast<std::size_t>(c) * static_cast<std::size_t>(dstWidth);
+            blendRows(scratch.rows[0].data() + rowOffset, scratch.rows[1].data() + rowOffset, a,
+                      dstWidth, dst + c * planeSize + dstOffset);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * Converts interleaved 8-bit 3-channel pixels (HWC) into planar float data (CHW).
+ * Rows are processed one after another and every output plane is written
+ * sequentially. The implementation is picked at runtime from the ISA supported
+ * by the CPU (AVX-512, AVX2, SSE4.1 or plain C++); all of them produce the same
+ * values as a plain static_cast<float>.
+ * @param src - pointer to the first pixel of the image
+ * @param srcStep - distance between image rows in bytes
+ * @param width - image width in pixels
+ * @param height - image height in pixels
+ * @param dst - output buffer for 3 * width * height floats
+ */
+void hwcToPlanar(const uint8_t* src, std::size_t srcStep, int width, int height, float* dst);
+
+/**
+ * Same as above for a CV_8UC3 image.
+ */
+void hwcToPlanar(const cv::Mat& img, float* dst);
+
+/**
+ * Bilinearly resizes a CV_8UC3 image and writes the result as planar float data
+ * (CHW) in a single pass, without materializing an intermediate 8-bit image.
+ * Sampling follows cv::resize with INTER_LINEAR; the output keeps the
+ * interpolated values in float instead of rounding them to 8 bits.
+ * Every source row is resampled horizontally at most once. Falls back to
+ * hwcToPlanar when no resizing is needed.
+ * @param src - source image
+ * @param dstSize - size of the output planes
+ * @param dst - output buffer for 3 * dstSize.area() floats
+ */
+void resizeToPlanar(const cv::Mat& src, cv::Size dstSize, float* dst);
+
+/**
+ * Name of the instruction set used by hwcToPlanar on this CPU.
+ */
+const char* hwcToPlanarIsa();
+
+/**
+ * Instruction sets with a hwcToPlanar kernel that runs on this CPU, best first.
+ */
+std::vector<std::string> hwcToPlanarIsas();
+
+/**
+ * hwcToPlanar with the kernel of the given instruction set, for checks and
+ * benchmarks. Returns false if there is no such kernel on this CPU.
+ */
+bool hwcToPlanar(const cv::Mat& img, float* dst, const std::string& isa);
@@ -0,0 +1,59 @@
+#include "roi_motion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+// Width the zone is reduced to before differencing, which also averages out sensor noise
+const int WorkWidth = 160;
+}  // namespace
+
+RoiMotionDetector::RoiMotionDetector(float threshold_, std::size_t refreshInterval_):
+    threshold(threshold_), refreshInterval(refreshInterval_) {}
+
+bool RoiMotionDetector::shouldInfer(const cv::Mat& frame, const cv::Rect2f& zone) {
+    bool moved = true;
+    if (!frame.empty()) {
+        cv::Rect area(0, 0, frame.cols, frame.rows);
+        if (zone.area() > 0.0f) {
+            area &= cv::Rect(static_cast<int>(zone.x * frame.cols), static_cast<int>(zone.y * frame.rows),
+                             static_cast<int>(std::ceil(zone.width * frame.cols)),
+                             static_cast<int>(std::ceil(zone.height * frame.rows)));
+        }
+        if (area.area() > 0) {
+            const cv::Mat crop = frame(area);
+            const int width = std::min(WorkWidth, area.width);
+            const int height = std::max(1, area.height * width / area.width);
+            cv::resize(crop, small, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+            if (1 == small.channels()) {
+                small.copyTo(gray);
+            } else {
+                cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+            }
+            if (gray.size() == reference.size()) {
+                cv::absdiff(gray, reference, diff);
+                cv::threshold(diff, diff, threshold, 255, cv::THRESH_BINARY);
+                // A few flickering pixels are not motion: require 0.5% of the zone to change
+                const int needed = std::max(1, static_cast<int>(gray.total() / 200));
+                moved = cv::countNonZero(diff) >= needed;
+            }
+        }
+    }
+    if (moved || (refreshInterval > 0 && sinceInferred + 1 >= refreshInterval)) {
+        // Compare against the last inferred frame, so a slow drift adds up and is not missed
+        std::swap(reference, gray);
+        sinceInferred = 0;
+        passed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    ++sinceInferred;
+    skipped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+float RoiMotionDetector::takeSkipRate() {
+    const std::uint32_t s = skipped.exchange(0, std::memory_order_relaxed);
+    const std::uint32_t p = passed.exchange(0, std::memory_order_relaxed);
+    return 0 == s + p ? 0.0f : static_cast<float>(s) / (s + p);
+}
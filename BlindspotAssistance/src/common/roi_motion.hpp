@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * Decides per camera whether a decoded frame is worth inferring: the frame is
+ * cropped to the camera's detection zone, downscaled and compared pixel by
+ * pixel with the zone of the last inferred frame. Every refreshInterval-th
+ * frame is inferred regardless, so the detections never get too old.
+ * Not thread safe except for takeSkipRate().
+ */
+class RoiMotionDetector {
+public:
+    // threshold: gray level change (0..255) of a downscaled pixel that counts as motion,
+    // refreshInterval: 0 never forces a frame through
+    RoiMotionDetector(float threshold, std::size_t refreshInterval);
+
+    // zone is given in fractions of the frame size; an empty zone covers the whole frame
+    bool shouldInfer(const cv::Mat& frame, const cv::Rect2f& zone);
+
+    // Share of frames skipped since the previous call
+    float takeSkipRate();
+
+private:
+    const double threshold;
+    const std::size_t refreshInterval;
+    std::size_t sinceInferred = 0;
+    cv::Mat small;
+    cv::Mat gray;
+    cv::Mat reference;
+    cv::Mat diff;
+    std::atomic<std::uint32_t> passed{0};
+    std::atomic<std::uint32_t> skipped{0};
+};
@@ -0,0 +1,165 @@
+#include "tracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Noise in fractions of the frame size
+const float MeasurementStd = 0.01f;
+const float AccelerationStd = 0.005f;
+const float InitialVelocityStd = 0.05f;
+
+float iou(const cv::Rect2f& a, const cv::Rect2f& b) {
+    const float inter = (a & b).area();
+    const float uni = a.area() + b.area() - inter;
+    return uni > 0.0f ? inter / uni : 0.0f;
+}
+}  // namespace
+
+void MultiObjectTracker::Axis::init(float value, float posVar, float velVar) {
+    pos = value;
+    vel = 0.0f;
+    p00 = posVar;
+    p01 = 0.0f;
+    p11 = velVar;
+}
+
+void MultiObjectTracker::Axis::predict(float accelVar) {
+    // x' = F x with F = [1 1; 0 1], P' = F P F^T + Q for a random acceleration over one frame
+    pos += vel;
+    p00 += 2.0f * p01 + p11 + accelVar * 0.25f;
+    p01 += p11 + accelVar * 0.5f;
+    p11 += accelVar;
+}
+
+void MultiObjectTracker::Axis::correct(float value, float measVar) {
+    const float s = p00 + measVar;
+    const float k0 = p00 / s;
+    const float k1 = p01 / s;
+    const float residual = value - pos;
+    pos += k0 * residual;
+    vel += k1 * residual;
+    p11 -= k1 * p01;
+    p01 -= k0 * p01;
+    p00 -= k0 * p00;
+}
+
+cv::Rect2f MultiObjectTracker::Track::rect() const {
+    const float width = std::max(0.0f, w.pos);
+    const float height = std::max(0.0f, h.pos);
+    return cv::Rect2f(cx.pos - width / 2, cy.pos - height / 2, width, height) & cv::Rect2f(0.0f, 0.0f, 1.0f, 1.0f);
+}
+
+MultiObjectTracker::MultiObjectTracker(float iouThreshold_, std::size_t maxMissed_):
+    iouThreshold(iouThreshold_), maxMissed(maxMissed_) {}
+
+void MultiObjectTracker::advance() {
+    const float accelVar = AccelerationStd * AccelerationStd;
+    for (auto& track : tracks) {
+        track.cx.predict(accelVar);
+        track.cy.predict(accelVar);
+        track.w.predict(accelVar);
+        track.h.predict(accelVar);
+    }
+}
+
+void MultiObjectTracker::correct(std::vector<Object>& detections) {
+    advance();
+
+    // Greedy association, best overlap first; there are only a handful of objects per camera
+    pairs.clear();
+    for (std::size_t t = 0; t < tracks.size(); ++t) {
+        const cv::Rect2f predicted = tracks[t].rect();
+        for (std::size_t d = 0; d < detections.size(); ++d) {
+            if (detections[d].label != tracks[t].label) {
+                continue;
+            }
+            const float overlap = iou(predicted, detections[d].rect);
+            if (overlap >= iouThreshold) {
+                pairs.push_back({overlap, t, d});
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.iou > b.iou; });
+    trackMatched.assign(tracks.size(), false);
+    detectionMatched.assign(detections.size(), false);
+
+    const float measVar = MeasurementStd * MeasurementStd;
+    for (auto& pair : pairs) {
+        if (trackMatched[pair.track] || detectionMatched[pair.detection]) {
+            continue;
+        }
+        trackMatched[pair.track] = true;
+        detectionMatched[pair.detection] = true;
+        auto& track = tracks[pair.track];
+        auto& detection = detections[pair.detection];
+        const auto& r = detection.rect;
+        track.cx.correct(r.x + r.width / 2, measVar);
+        track.cy.correct(r.y + r.height / 2, measVar);
+        track.w.correct(r.width, measVar);
+        track.h.correct(r.height, measVar);
+        track.confidence = detection.confidence;
+        track.missed = 0;
+        detection.id = track.id;
+    }
+
+    // Tracks stay for a few keyframes without a match, so a single missed detection does not lose the id
+    std::size_t kept = 0;
+    for (std::size_t t = 0; t < tracks.size(); ++t) {
+        if (!trackMatched[t] && ++tracks[t].missed > maxMissed) {
+            continue;
+        }
+        if (kept != t) {
+            tracks[kept] = tracks[t];
+        }
+        ++kept;
+    }
+    tracks.resize(kept);
+
+    const float velVar = InitialVelocityStd * InitialVelocityStd;
+    for (std::size_t d = 0; d < detections.size(); ++d) {
+        if (detectionMatched[d]) {
+            continue;
+        }
+        auto& detection = detections[d];
+        const auto& r = detection.rect;
+        Track track;
+        track.cx.init(r.x + r.width / 2, measVar, velVar);
+        track.cy.init(r.y + r.height / 2, measVar, velVar);
+        track.w.init(r.width, measVar, velVar);
+        track.h.init(r.height, measVar, velVar);
+        track.label = detection.label;
+        track.confidence = detection.confidence;
+        track.id = nextId++;
+        detection.id = track.id;
+        tracks.push_back(track);
+    }
+}
+
+void MultiObjectTracker::predict(std::vector<Object>& objects) {
+    advance();
+    objects.clear();
+    for (auto& track : tracks) {
+        if (0 != track.missed) {
+            continue;  // only objects the detector saw last time are shown
+        }
+        Object object;
+        object.rect = track.rect();
+        object.label = track.label;
+        object.confidence = track.confidence;
+        object.id = track.id;
+        if (object.rect.area() > 0.0f) {
+            objects.push_back(object);
+        }
+    }
+}
+
+float MultiObjectTracker::motionPerFrame() const {
+    float motion = 0.0f;
+    for (auto& track : tracks) {
+        if (0 == track.missed && track.h.pos > 0.0f) {
+            motion = std::max(motion, std::hypot(track.cx.vel, track.cy.vel) / track.h.pos);
+        }
+    }
+    return motion;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/**
+ * Multi-object tracker for one camera. Tracks are matched to detections by
+ * IoU and follow a constant-velocity Kalman filter per box coordinate, so
+ * they can be moved forward on frames the detector does not see.
+ * Call correct() for every detector keyframe and predict() for every frame
+ * in between, in capture order. Coordinates are fractions of the frame size.
+ */
+class MultiObjectTracker final {
+public:
+    struct Object {
+        cv::Rect2f rect;
+        int label = 0;
+        float confidence = 0.0f;
+        int id = -1;  // assigned by the tracker
+    };
+
+    /**
+     * @param iouThreshold - smallest IoU of a predicted track and a detection of the same label that match
+     * @param maxMissed - keyframes a track survives without a matching detection
+     */
+    MultiObjectTracker(float iouThreshold, std::size_t maxMissed);
+
+    // Advances the tracks by one frame and matches them to the detector output, whose ids are set
+    void correct(std::vector<Object>& detections);
+
+    // Advances the tracks by one frame and returns those matched on the last keyframe
+    void predict(std::vector<Object>& objects);
+
+    // Largest distance a track moves per frame, relative to its height
+    float motionPerFrame() const;
+
+private:
+    // Position and velocity of one coordinate
+    struct Axis {
+        float pos = 0.0f;
+        float vel = 0.0f;
+        float p00 = 0.0f;
+        float p01 = 0.0f;
+        float p11 = 0.0f;
+
+        void init(float value, float posVar, float velVar);
+        void predict(float accelVar);
+        void correct(float value, float measVar);
+    };
+
+    struct Track {
+        Axis cx, cy, w, h;
+        int label = 0;
+        float confidence = 0.0f;
+        int id = 0;
+        std::size_t missed = 0;
+
+        cv::Rect2f rect() const;
+    };
+
+    const float iouThreshold;
+    const std::size_t maxMissed;
+    std::vector<Track> tracks;
+    int nextId = 0;
+
+    // Reused between keyframes
+    struct Pair {
+        float iou;
+        std::size_t track;
+        std::size_t detection;
+    };
+    std::vector<Pair> pairs;
+    std::vector<bool> trackMatched;
+    std::vector<bool> detectionMatched;
+
+    void advance();
+};
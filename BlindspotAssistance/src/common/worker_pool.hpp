@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of threads running submitted jobs in FIFO order. Jobs may finish
+ * in any order; callers that need ordered results sequence them themselves.
+ */
+class WorkerPool final {
+public:
+    explicit WorkerPool(std::size_t threads);
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator =(const WorkerPool&) = delete;
+    // Runs the jobs that are still queued, then joins the threads
+    ~WorkerPool();
+
+    void submit(std::function<void()> job);
+
+    std::size_t size() const {
+        return threads.size();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable hasJob;
+    std::queue<std::function<void()>> jobs;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    void run();
+};
+
+/**
+ * Pool that software decoders run on, one thread per core. It is never
+ * destroyed, so decoders may finish their last frames during shutdown.
+ */
+WorkerPool& getDecodePool();
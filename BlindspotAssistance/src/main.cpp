@@ -21,6 +21,7 @@
 #include <memory>
 #include <string>
 #include <fstream>
+#include <future>
 
 #ifdef USE_TBB
 #include <tbb/parallel_for.h>
@@ -39,6 +40,11 @@
 #include "output.hpp"
 #include "threading.hpp"
 #include "graph.hpp"
+#include "object_pool.hpp"
+#include "frame_scheduler.hpp"
+#include "roi_motion.hpp"
+#include "tracker.hpp"
+#include "autotune.hpp"
 
 #include "alert_publisher.hpp"
 #include "vehicle_status.hpp"
@@ -68,7 +74,15 @@ namespace
         std::cout << "    -fps_sp                      " << fps_sampling_period << std::endl;
         std::cout << "    -n_sp                        " << num_sampling_periods << std::endl;
         std::cout << "    -pc                          " << performance_counter_message << std::endl;
+        std::cout << "    -nstreams                    " << cpu_streams_message << std::endl;
+        std::cout << "    -nthreads                    " << cpu_threads_message << std::endl;
+        std::cout << "    -pin                         " << cpu_bind_message << std::endl;
+        std::cout << "    -autotune                    " << autotune_message << std::endl;
+        std::cout << "    -autotune_out                " << autotune_out_message << std::endl;
         std::cout << "    -t                           " << thresh_output_message << std::endl;
+        std::cout << "    -roi_motion                  " << roi_motion_message << std::endl;
+        std::cout << "    -roi_refresh                 " << roi_refresh_message << std::endl;
+        std::cout << "    -det_interval                " << det_interval_message << std::endl;
         std::cout << "    -no_show                     " << no_show_processed_video << std::endl;
         std::cout << "    -no_show_d                   " << no_show_detection << std::endl;
         std::cout << "    -show_stats                  " << show_statistics << std::endl;
@@ -82,6 +96,21 @@ namespace
         std::cout << "    -alerts                      " << alerts_message << std::endl;
         std::cout << "    -dm                          " << driver_mode << std::endl;
         std::cout << "    -msg_bus                     " << eis_msg_bus << std::endl;
+        std::cout << "    -ie_preproc                  " << ie_preprocessing_message << std::endl;
+        std::cout << "    -async_completion            " << async_completion_message << std::endl;
+        std::cout << "    -ordered                     " << ordered_results_message << std::endl;
+        std::cout << "    -producers                   " << producers_message << std::endl;
+        std::cout << "    -batch_deadline_ms           " << batch_deadline_message << std::endl;
+        std::cout << "    -dyn_batch                   " << dynamic_batch_message << std::endl;
+        std::cout << "    -mode_budgets                " << mode_budgets_message << std::endl;
+        std::cout << "    -rear_cam                    " << rear_camera_message << std::endl;
+        std::cout << "    -side_cams                   " << side_cameras_message << std::endl;
+        std::cout << "    -parking_fps                 " << parking_fps_message << std::endl;
+        std::cout << "    -cache_dir                   " << cache_dir_message << std::endl;
+        std::cout << "    -mjpeg_index                 " << mjpeg_index_message << std::endl;
+        std::cout << "    -latest_frame                " << latest_frame_message << std::endl;
+        std::cout << "    -lazy_decode                 " << lazy_decode_message << std::endl;
+        std::cout << "    -motion_threshold            " << motion_threshold_message << std::endl;
     }
 
     bool ParseAndCheckCommandLine(int argc, char *argv[])
@@ -104,6 +133,32 @@ namespace
         {
             throw std::logic_error("Please specify at least one video source(web cam or video file)");
         }
+        if (FLAGS_ordered && !FLAGS_async_completion)
+        {
+            throw std::logic_error("Parameter -ordered requires -async_completion");
+        }
+        if (0 == FLAGS_det_interval)
+        {
+            throw std::logic_error("Parameter -det_interval must be at least 1");
+        }
+        if (FLAGS_det_interval > 1 && FLAGS_async_completion && !FLAGS_ordered)
+        {
+            // The tracker needs the frames of a camera in capture order
+            throw std::logic_error("Parameter -det_interval with -async_completion requires -ordered");
+        }
+        if (!FLAGS_nstreams.empty() && FLAGS_nstreams != "auto" &&
+            (FLAGS_nstreams.find_first_not_of("0123456789") != std::string::npos || 0 == std::stoul(FLAGS_nstreams)))
+        {
+            throw std::logic_error("Parameter -nstreams must be a positive number or auto");
+        }
+        if (FLAGS_pin != "NO" && FLAGS_pin != "YES" && FLAGS_pin != "NUMA")
+        {
+            throw std::logic_error("Parameter -pin must be NO, YES or NUMA");
+        }
+        if ((FLAGS_autotune || !FLAGS_tune_report.empty()) && FLAGS_n_sp < 2)
+        {
+            throw std::logic_error("Parameter -autotune requires -n_sp of at least 2");
+        }
         slog::info << "\tDetection model:           " << FLAGS_m << slog::endl;
         slog::info << "\tDetection threshold:       " << FLAGS_t << slog::endl;
         slog::info << "\tUtilizing device:          " << FLAGS_d << slog::endl;
@@ -118,6 +173,8 @@ namespace
         slog::info << "\tBatch size:                " << FLAGS_bs << slog::endl;
         slog::info << "\tNumber of infer requests:  " << FLAGS_nireq << slog::endl;
         slog::info << "\tNumber of input web cams:  " << FLAGS_nc << slog::endl;
+        slog::info << "\tIE preprocessing:          " << (FLAGS_ie_preproc ? "ON" : "OFF") << slog::endl;
+        slog::info << "\tCompletion callbacks:      " << (FLAGS_async_completion ? (FLAGS_ordered ? "ON (ordered)" : "ON") : "OFF") << slog::endl;
 
         return true;
     }
@@ -127,6 +184,7 @@ namespace
         cv::Rect2f rect;
         int label;
         float confidence;
+        int id = -1;  // track id, with -det_interval only
         Detection(cv::Rect2f r, int l, float c) : rect(r), label(l), confidence(c) {}
     };
 
@@ -134,8 +192,70 @@ namespace
     const size_t DISP_WIDTH = 1280;
     const size_t DISP_HEIGHT = 720;
     const size_t MAX_INPUTS = 4;
+    const float REAR_CAM_PRIORITY = 4.0f;  // weight of the rear camera channels in Reverse mode
+    const float SIDE_CAM_PRIORITY = 4.0f;  // weight of the side camera channels on the highway
+    const float REDUCED_FPS = 5.0f;        // cameras that matter less in the current mode
+    const float MAX_TRACK_STEP = 0.25f;    // share of its height an object may move between detector keyframes
+
+    enum class CameraRole
+    {
+        Other,
+        Side,
+        Rear
+    };
+
+    struct InferenceBudget
+    {
+        float priority;
+        float maxFps;  // 0: as many frames as the scheduler can give it
+    };
+
+    // Share of the inference a camera gets in a driving mode: cameras watching where the danger
+    // comes from are preferred, and the others slow down while they matter less
+    InferenceBudget modeBudget(Modes mode, CameraRole role)
+    {
+        if (!FLAGS_mode_budgets)
+        {
+            return {1.0f, 0.0f};
+        }
+        switch (mode)
+        {
+        case Modes::parking:
+            return {1.0f, static_cast<float>(FLAGS_parking_fps)};
+        case Modes::surveillance:
+            return {1.0f, REDUCED_FPS};
+        case Modes::reverse:
+            // Without a rear camera no camera is worth slowing the others down for
+            if (0 == FLAGS_rear_cam)
+            {
+                return {1.0f, 0.0f};
+            }
+            return CameraRole::Rear == role ? InferenceBudget{REAR_CAM_PRIORITY, 0.0f} : InferenceBudget{1.0f, REDUCED_FPS};
+        case Modes::highway:
+            return {CameraRole::Side == role ? SIDE_CAM_PRIORITY : 1.0f, 0.0f};
+        default:
+            return {1.0f, 0.0f};
+        }
+    }
+
+    // Detector keyframe interval for the driving mode: objects pass quickly on the highway
+    // and hardly move around a parked car
+    unsigned modeKeyframeInterval(Modes mode)
+    {
+        switch (mode)
+        {
+        case Modes::highway:
+            return std::max(1u, FLAGS_det_interval / 2);
+        case Modes::parking:
+        case Modes::surveillance:
+            return FLAGS_det_interval * 2;
+        default:
+            return FLAGS_det_interval;
+        }
+    }
     bool firstTime = true;
     cv::Rect2d roi[MAX_INPUTS];
+    std::mutex roiMutex;  // roi is set by the output thread and read by the batch producers
     int camDetections[MAX_INPUTS];
     Publisher* g_publisher = NULL;
     MessageQueue* g_input_queue = NULL;
@@ -160,6 +280,10 @@ namespace
             cv::Rect ri(static_cast<int>(f.rect.x * img.cols), static_cast<int>(f.rect.y * img.rows),
                         static_cast<int>(f.rect.width * img.cols), static_cast<int>(f.rect.height * img.rows));
             cv::rectangle(img, ri, color, 2);
+            if (f.id >= 0)
+            {
+                cv::putText(img, std::to_string(f.id), ri.tl() + cv::Point(2, 12), cv::HersheyFonts::FONT_HERSHEY_SIMPLEX, 0.4, color, 1);
+            }
         }
     }
 
@@ -184,7 +308,7 @@ namespace
         g_input_queue->push(wrap);
     }
 
-    int areaDetectionCount(cv::Mat &img, const std::vector<Detection> &detections, size_t i, cv::Rect2d roi, VehicleStatus *vehicle)
+    int areaDetectionCount(cv::Mat &img, const std::vector<Detection> &detections, size_t sourceIdx, cv::Rect2d roi, VehicleStatus *vehicle)
     {
         int count = 0;
 
@@ -203,7 +327,7 @@ namespace
 
                     // Send alert if enable
                     if (strlen(FLAGS_msg_bus.c_str()) > 0 && FLAGS_alerts){
-                        alertHandler(i+1, f, vehicle);
+                        alertHandler(sourceIdx + 1, f, vehicle);
                     } 
                 }
             }
@@ -292,10 +416,27 @@ namespace
                          DisplayParams params, Presenter &presenter,
                          VehicleStatus *vehicle)
     {
-        cv::Mat windowImage = cv::Mat::zeros(params.windowSize, CV_8UC3);
+        // Only the output thread renders, so the window buffer is reused between frames
+        static cv::Mat windowImage;
+        windowImage.create(params.windowSize, CV_8UC3);
+        windowImage.setTo(cv::Scalar::all(0));
+        // Batches may miss channels or hold them in any order, so tiles follow sourceIdx,
+        // and a channel without a new frame keeps showing its last one
+        static std::vector<std::shared_ptr<VideoFrame>> shown;
+        static std::vector<bool> fresh;
+        shown.resize(params.count);
+        fresh.assign(params.count, false);
+        for (auto &elem : data)
+        {
+            if (elem->sourceIdx < shown.size())
+            {
+                shown[elem->sourceIdx] = elem;
+                fresh[elem->sourceIdx] = true;
+            }
+        }
         auto loopBody = [&](size_t i) {
-            auto &elem = data[i];
-            if (!elem->frame.empty())
+            auto &elem = shown[i];
+            if (elem && !elem->frame.empty())
             {
                 cv::Rect rectFrame = cv::Rect(params.points[i], params.frameSize);
                 cv::Mat windowPart = windowImage(rectFrame);
@@ -304,7 +445,11 @@ namespace
                 {
                     drawDetections(windowPart, elem->detections.get<std::vector<Detection>>());
                 }
-                camDetections[i] = areaDetectionCount(windowPart, elem->detections.get<std::vector<Detection>>(), i, roi[i], vehicle);
+                if (fresh[i])
+                {
+                    // Counted once per frame, so a repeated frame raises no new alerts
+                    camDetections[i] = areaDetectionCount(windowPart, elem->detections.get<std::vector<Detection>>(), i, roi[i], vehicle);
+                }
             }
         };
 
@@ -332,12 +477,12 @@ namespace
 //  #ifdef USE_TBB
 #if 0 // disable multithreaded rendering for now
     run_in_arena([&](){
-        tbb::parallel_for<size_t>(0, data.size(), [&](size_t i) {
+        tbb::parallel_for<size_t>(0, shown.size(), [&](size_t i) {
             loopBody(i);
         });
     });
 #else
-        for (size_t i = 0; i < data.size(); ++i)
+        for (size_t i = 0; i < shown.size(); ++i)
         {
             loopBody(i);
         }
@@ -348,10 +493,12 @@ namespace
         if (FLAGS_calibration && firstTime)
         {
             std::cout << "Start area detection configuration" << std::endl;
-            for (int i = 0; i < MAX_INPUTS; i++)
+            for (size_t i = 0; i < params.count; i++)
             {
                 std::cout << "Selec Area Detection. Cam: " << std::to_string(i + 1) << std::endl;
-                roi[i] = areaDetection(windowImage, i, params.points[i], params.frameSize);
+                auto area = areaDetection(windowImage, static_cast<int>(i), params.points[i], params.frameSize);
+                std::lock_guard<std::mutex> lock(roiMutex);
+                roi[i] = area;
             }
             /* saveArea(roi); */
             firstTime = false;
@@ -360,7 +507,7 @@ namespace
         // Draw Area Detection
         if (FLAGS_show_calibration)
         {
-            for (int i = 0; i < MAX_INPUTS; i++)
+            for (size_t i = 0; i < params.count; i++)
             {
                 drawAreaDetection(windowImage, roi[i], params.points[i]);
             }
@@ -383,6 +530,9 @@ namespace
 
 int main(int argc, char *argv[])
 {
+    const auto startupBegin = std::chrono::steady_clock::now();
+    // Parsing removes the flags from argv, -autotune passes them on to its trial runs
+    const std::vector<std::string> args(argv, argv + argc);
     try
     {
         VehicleStatus vehicle;
@@ -397,28 +547,63 @@ int main(int argc, char *argv[])
             return 0;
         }
 
+        if (FLAGS_autotune) {
+            TuneConfig start;
+            start.batchSize = FLAGS_bs;
+            start.requests = FLAGS_nireq;
+            start.inputQueueSize = FLAGS_n_iqs;
+            if (FLAGS_nstreams == "auto") {
+                start.streams = IEGraph::autoCpuStreams(FLAGS_nireq, FLAGS_nthreads);
+            } else if (!FLAGS_nstreams.empty()) {
+                start.streams = std::stoul(FLAGS_nstreams);
+            }
+            const std::string reportPath = FLAGS_autotune_out + ".trial";
+            // Every configuration runs in a fresh process, so no state carries over between them
+            AutoTuner tuner(start, FLAGS_d.find("CPU") != std::string::npos,
+                            [&](const TuneConfig& config, TuneResult& result) {
+                auto trialArgs = args;
+                trialArgs.insert(trialArgs.end(), {
+                    "-autotune=false", "-no_show=true", "-alerts=false",
+                    // The mocked vehicle changes mode during a run, which would change the
+                    // budgets and keyframe interval between trials, so the mode is pinned
+                    "-dm=" + (FLAGS_dm.empty() ? std::string("urban") : FLAGS_dm),
+                    "-bs=" + std::to_string(config.batchSize),
+                    "-nireq=" + std::to_string(config.requests),
+                    "-n_iqs=" + std::to_string(config.inputQueueSize),
+                    "-nstreams=" + (0 != config.streams ? std::to_string(config.streams) : std::string()),
+                    "-tune_report=" + reportPath});
+                return runTrialProcess(trialArgs, reportPath, result);
+            });
+            tuner.run();
+            auto front = tuner.paretoFront();
+            AutoTuner::writeReport(FLAGS_autotune_out, front);
+            slog::info << "Auto tuning: " << front.size() << " Pareto-optimal configurations written to "
+                       << FLAGS_autotune_out << slog::endl;
+            return 0;
+        }
+
         // Setting EIS Message Bus publisher ----------------------
         const char* msg_bus_config = FLAGS_msg_bus.c_str();
 
+        // The publisher connects to the bus while the network compiles and the sources open.
+        // Alerts pushed before it has started wait in the input queue.
+        std::condition_variable err_cv;
+        std::future<void> publisherReady;
         if(strlen(msg_bus_config) > 0 && FLAGS_alerts){
-            //Loading JSON config file
-            config_t* pub_config = json_config_new(msg_bus_config);
-            if(pub_config == NULL) {
-                LOG_ERROR_0("Failed to load JSON configuration");
-                return -1;
-            }
-
-            std::condition_variable err_cv;
-
             g_input_queue = new MessageQueue(-1);
-            g_publisher = new Publisher(
-                    pub_config, err_cv, TOPIC, g_input_queue,
-                    SERVICE_NAME);
-            g_publisher->start();
-
-            // Give time to initialize publisher
-            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            publisherReady = std::async(std::launch::async, [msg_bus_config, &err_cv]() {
+                //Loading JSON config file
+                config_t* pub_config = json_config_new(msg_bus_config);
+                if(pub_config == NULL) {
+                    LOG_ERROR_0("Failed to load JSON configuration");
+                    throw std::runtime_error("Failed to load message bus configuration");
+                }
 
+                g_publisher = new Publisher(
+                        pub_config, err_cv, TOPIC, g_input_queue,
+                        SERVICE_NAME);
+                g_publisher->start();
+            });
         }
 
         readArea();
@@ -437,26 +622,58 @@ int main(int argc, char *argv[])
         graphParams.maxRequests = FLAGS_nireq;
         graphParams.collectStats = FLAGS_show_stats;
         graphParams.reportPerf = FLAGS_pc;
+        graphParams.iePreprocessing = FLAGS_ie_preproc;
+        graphParams.completionCallbacks = FLAGS_async_completion;
+        graphParams.orderedResults = FLAGS_ordered;
+        graphParams.trackedFrames = FLAGS_det_interval > 1;
+        graphParams.batchDeadline = std::chrono::milliseconds(FLAGS_batch_deadline_ms);
+        graphParams.dynamicBatch = FLAGS_dyn_batch;
         graphParams.modelPath = modelPath;
+        graphParams.compiledCacheDir = FLAGS_cache_dir;
         graphParams.cpuExtPath = FLAGS_l;
         graphParams.cldnnConfigPath = FLAGS_c;
+        graphParams.cpuStreams = FLAGS_nstreams;
+        graphParams.cpuThreads = FLAGS_nthreads;
+        graphParams.cpuBindThread = FLAGS_pin;
         graphParams.deviceName = FLAGS_d;
 
-        std::shared_ptr<IEGraph> network(new IEGraph(graphParams));
-        auto inputDims = network->getInputDims();
+        std::vector<std::string> files;
+        parseInputFilesArguments(files);
+
+        // A camera is served by a single producer, so there is no point in having more producers than cameras
+        const size_t numberOfCameras = FLAGS_nc + files.size();
+        graphParams.producers = std::max<size_t>(1, std::min<size_t>(FLAGS_producers, numberOfCameras));
+
+        // The sources only need the input size, which is known long before the network is compiled
+        std::promise<InferenceEngine::SizeVector> inputReady;
+        auto inputReadyFuture = inputReady.get_future();
+        graphParams.inputReadyFunc = [&inputReady](const InferenceEngine::SizeVector& dims) {
+            inputReady.set_value(dims);
+        };
+        auto networkReady = std::async(std::launch::async, [&graphParams, &inputReady]() {
+            try {
+                return std::shared_ptr<IEGraph>(new IEGraph(graphParams));
+            } catch (...) {
+                try {
+                    inputReady.set_exception(std::current_exception());
+                } catch (const std::future_error&) {
+                    // the input size was already handed out, the error surfaces from the network future
+                }
+                throw;
+            }
+        });
+        auto inputDims = inputReadyFuture.get();
         if (4 != inputDims.size()) {
             throw std::runtime_error("Invalid network input dimensions");
         }
 
-        std::vector<std::string> files;
-        parseInputFilesArguments(files);
-
         slog::info << "\tNumber of input web cams:    " << FLAGS_nc << slog::endl;
         slog::info << "\tNumber of input video files: " << files.size() << slog::endl;
         slog::info << "\tDuplication multiplayer:     " << FLAGS_duplicate_num << slog::endl;
+        slog::info << "\tNumber of batch producers:   " << graphParams.producers << slog::endl;
 
         const auto duplicateFactor = (1 + FLAGS_duplicate_num);
-        size_t numberOfInputs = (FLAGS_nc + files.size()) * duplicateFactor;
+        size_t numberOfInputs = numberOfCameras * duplicateFactor;
 
         if (numberOfInputs == 0) {
             throw std::runtime_error("No valid inputs were supplied");
@@ -473,43 +690,152 @@ int main(int argc, char *argv[])
         vsParams.queueSize = FLAGS_n_iqs;
         vsParams.collectStats = FLAGS_show_stats;
         vsParams.realFps = FLAGS_real_input_fps;
+        vsParams.mjpegIndexFile = FLAGS_mjpeg_index;
+        vsParams.latestFrame = FLAGS_latest_frame;
+        vsParams.lazyDecode = FLAGS_lazy_decode;
+        vsParams.motionThreshold = static_cast<float>(FLAGS_motion_threshold);
         vsParams.expectedHeight = static_cast<unsigned>(inputDims[2]);
         vsParams.expectedWidth = static_cast<unsigned>(inputDims[3]);
 
         VideoSources sources(vsParams);
+        std::vector<VideoSources::SourceDesc> sourceDescs;
         if (!files.empty()) {
             slog::info << "Trying to open input video ..." << slog::endl;
             for (auto &file : files){
-                try{
-                    sources.openVideo(file, false, FLAGS_loop_video);
-                }
-                catch (...){
-                    slog::info << "Cannot open video [" << file << "]" << slog::endl;
-                    throw;
-                }
+                sourceDescs.push_back({file, false, FLAGS_loop_video});
             }
         }
         if (FLAGS_nc) {
             slog::info << "Trying to connect " << FLAGS_nc << " web cams ..." << slog::endl;
             for (size_t i = 0; i < FLAGS_nc; ++i){
-                try{
-                    sources.openVideo(std::to_string(i), true, false);
-                }
-                catch (...){
-                    slog::info << "Cannot open web cam [" << i << "]" << slog::endl;
-                    throw;
-                }
+                sourceDescs.push_back({std::to_string(i), true, false});
             }
         }
+        sources.openVideos(sourceDescs);
+
+        std::shared_ptr<IEGraph> network = networkReady.get();
+        if (publisherReady.valid()) {
+            publisherReady.get();
+        }
+        slog::info << "Startup took " << std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startupBegin).count() << "ms" << slog::endl;
         sources.start();
 
-        size_t currentFrame = 0;
+        // Producer p serves the channels of cameras p, p + producers, ...,
+        // so the frames of every camera are submitted in order by one thread
+        const size_t producers = graphParams.producers;
+        std::vector<std::vector<size_t>> producerChannels(producers);
+        for (size_t channel = 0; channel < numberOfInputs; ++channel) {
+            producerChannels[(channel / duplicateFactor) % producers].push_back(channel);
+        }
+        FrameScheduler scheduler(std::move(producerChannels), [&](size_t channel) {
+            return sources.readySince(channel / duplicateFactor);
+        });
+        if (FLAGS_rear_cam > numberOfCameras) {
+            throw std::logic_error("Parameter -rear_cam exceeds the number of cameras");
+        }
+        if (FLAGS_parking_fps < 0.0) {
+            throw std::logic_error("Parameter -parking_fps must not be negative");
+        }
+        std::vector<CameraRole> cameraRoles(numberOfCameras, CameraRole::Other);
+        if (FLAGS_rear_cam > 0) {
+            cameraRoles[FLAGS_rear_cam - 1] = CameraRole::Rear;
+        }
+        std::stringstream sideCams(FLAGS_side_cams);
+        for (std::string cam; std::getline(sideCams, cam, ',');) {
+            unsigned long number = 0;
+            try {
+                number = std::stoul(cam);
+            } catch (const std::exception &) {
+                throw std::logic_error("Parameter -side_cams must list camera numbers");
+            }
+            if (0 == number || number > numberOfCameras) {
+                throw std::logic_error("Parameter -side_cams exceeds the number of cameras");
+            }
+            cameraRoles[number - 1] = CameraRole::Side;
+        }
+        std::vector<InferenceBudget> cameraBudgets(numberOfCameras, InferenceBudget{1.0f, 0.0f});
+        // The output thread updates vehicle for alerts, so the scheduler follows its own copy
+        VehicleStatus drivingStatus;
+        unsigned modeInterval = FLAGS_det_interval;
+        auto updateDrivingMode = [&]() {
+            drivingStatus.find_mode();
+            modeInterval = modeKeyframeInterval(drivingStatus.get_mode());
+            // The scheduler enforces the budgets, so compute follows the cameras that matter in this mode
+            for (size_t cam = 0; cam < numberOfCameras; ++cam) {
+                cameraBudgets[cam] = modeBudget(drivingStatus.get_mode(), cameraRoles[cam]);
+                for (size_t d = 0; d < duplicateFactor; ++d) {
+                    scheduler.setPriority(cam * duplicateFactor + d, cameraBudgets[cam].priority);
+                    scheduler.setMaxRate(cam * duplicateFactor + d, cameraBudgets[cam].maxFps);
+                }
+            }
+        };
+        updateDrivingMode();
 
-        network->start([&](VideoFrame &img) {
-            img.sourceIdx = currentFrame;
-            auto camIdx = currentFrame / duplicateFactor;
-            currentFrame = (currentFrame + 1) % numberOfInputs;
-            return sources.getFrame(camIdx, img); }, [](InferenceEngine::InferRequest::Ptr req, const std::vector<std::string> &outputDataBlobNames, cv::Size frameSize) {
+        // A channel is only read by its producer, so every channel gets its own detector
+        std::vector<std::unique_ptr<RoiMotionDetector>> roiMotion;
+        if (FLAGS_roi_motion > 0.0) {
+            for (size_t channel = 0; channel < numberOfInputs; ++channel) {
+                roiMotion.emplace_back(new RoiMotionDetector(static_cast<float>(FLAGS_roi_motion), FLAGS_roi_refresh));
+            }
+        }
+        // With -det_interval the detector sees only keyframes and a tracker per channel covers the other frames.
+        // The main thread tracks and picks the interval, the producer of the channel marks its keyframes.
+        std::vector<MultiObjectTracker> trackers;
+        std::vector<std::atomic<unsigned>> keyframeIntervals(FLAGS_det_interval > 1 ? numberOfInputs : 0);
+        std::vector<size_t> framesSinceKeyframe(keyframeIntervals.size(), 0);
+        for (auto &interval : keyframeIntervals) {
+            interval = modeInterval;
+            trackers.emplace_back(0.3f, 2);
+        }
+        std::vector<MultiObjectTracker::Object> trackedObjects;
+
+        // The detection area of a channel in fractions of its display tile
+        auto channelArea = [&](size_t channel) {
+            std::lock_guard<std::mutex> lock(roiMutex);
+            const cv::Rect2d& area = roi[channel];
+            return cv::Rect2f(static_cast<float>(area.x / params.frameSize.width),
+                              static_cast<float>(area.y / params.frameSize.height),
+                              static_cast<float>(area.width / params.frameSize.width),
+                              static_cast<float>(area.height / params.frameSize.height));
+        };
+
+        // Released vectors keep their capacity, so steady state detections do not allocate
+        ObjectPool<std::vector<Detection>> detectionsPool((FLAGS_nireq + 2) * FLAGS_bs * 2,
+                                                          [](std::vector<Detection> &d) { d.clear(); });
+
+        network->start([&](VideoFrame &img, size_t producer, FrameDeadline deadline) {
+            // Only cameras with a frame at hand are read; otherwise wait for any of them to get one
+            auto arrivals = sources.frameArrivals();
+            size_t skippedReads = 0;
+            while (true) {
+                auto channel = scheduler.next(producer, std::chrono::steady_clock::now());
+                if (FrameScheduler::None != channel) {
+                    img.sourceIdx = channel;
+                    auto status = sources.getFrame(channel / duplicateFactor, img, deadline);
+                    if (FrameStatus::Ready == status && !roiMotion.empty() &&
+                        !roiMotion[channel]->shouldInfer(img.frame, channelArea(channel))) {
+                        // Nothing moved in the camera's detection area. Sources that repeat their last
+                        // frame stay ready, so after a round of skips wait for a new frame to arrive
+                        if (0 == ++skippedReads % numberOfInputs && !sources.waitForFrames(arrivals, deadline)) {
+                            return FrameStatus::NotReady;
+                        }
+                        continue;
+                    }
+                    if (FrameStatus::Ready == status && !keyframeIntervals.empty()) {
+                        auto &since = framesSinceKeyframe[channel];
+                        img.infer = 0 == since;
+                        since = since + 1 >= keyframeIntervals[channel] ? 0 : since + 1;
+                    }
+                    return status;
+                }
+                // A ready camera held back by its budget is due again before the next frame may arrive
+                auto due = std::min(deadline, scheduler.nextDue(producer));
+                if (!sources.waitForFrames(arrivals, due) && due == deadline) {
+                    return FrameStatus::NotReady;
+                }
+            } }, [&detectionsPool](InferenceEngine::InferRequest::Ptr req, const std::vector<std::string> &outputDataBlobNames, cv::Size frameSize,
+                                                          const std::vector<std::shared_ptr<VideoFrame>> &frames) {
             auto output = req->GetBlob(outputDataBlobNames[0]);
 
             float* dataPtr = output->buffer();
@@ -520,9 +846,8 @@ int main(int argc, char *argv[])
             }
 
 
-            std::vector<Detections> detections(FLAGS_bs);
-            for (auto& d : detections) {
-                d.set(new std::vector<Detection>);
+            for (auto& f : frames) {
+                f->detections.set(detectionsPool.acquire());
             }
 
             for (size_t i = 0; i < total; i+=7) {
@@ -530,19 +855,56 @@ int main(int argc, char *argv[])
                 float label = dataPtr[i + 1];
                 if (conf > FLAGS_t) {
                     int idxInBatch = static_cast<int>(dataPtr[i]);
+                    if (idxInBatch < 0 || static_cast<size_t>(idxInBatch) >= frames.size()) {
+                        continue; // padding of a partial batch
+                    }
                     float x0 = std::min(std::max(0.0f, dataPtr[i + 3]), 1.0f);
                     float y0 = std::min(std::max(0.0f, dataPtr[i + 4]), 1.0f);
                     float x1 = std::min(std::max(0.0f, dataPtr[i + 5]), 1.0f);
                     float y1 = std::min(std::max(0.0f, dataPtr[i + 6]), 1.0f);
 
                     cv::Rect2f rect = {x0 , y0, x1-x0, y1-y0};
-                    detections[idxInBatch].get<std::vector<Detection>>().emplace_back(rect, label, conf);
+                    frames[idxInBatch]->detections.get<std::vector<Detection>>().emplace_back(rect, label, conf);
                 }
-            }
-            return detections; });
+            }});
 
         network->setDetectionConfidence(static_cast<float>(FLAGS_t));
 
+        auto trackFrame = [&](VideoFrame &frame) {
+            const size_t channel = frame.sourceIdx;
+            auto &tracker = trackers[channel];
+            trackedObjects.clear();
+            if (frame.infer) {
+                auto &detections = frame.detections.get<std::vector<Detection>>();
+                for (auto &d : detections) {
+                    MultiObjectTracker::Object object;
+                    object.rect = d.rect;
+                    object.label = d.label;
+                    object.confidence = d.confidence;
+                    trackedObjects.push_back(object);
+                }
+                tracker.correct(trackedObjects);
+                for (size_t k = 0; k < detections.size(); ++k) {
+                    detections[k].id = trackedObjects[k].id;
+                }
+                // Detect more often while something moves fast enough to get lost between keyframes
+                unsigned interval = modeInterval;
+                float motion = tracker.motionPerFrame();
+                if (motion > 0.0f) {
+                    interval = std::min(interval, std::max(1u, static_cast<unsigned>(MAX_TRACK_STEP / motion)));
+                }
+                keyframeIntervals[channel] = interval;
+            } else {
+                tracker.predict(trackedObjects);
+                auto detections = detectionsPool.acquire();
+                for (auto &object : trackedObjects) {
+                    detections->emplace_back(object.rect, object.label, object.confidence);
+                    detections->back().id = object.id;
+                }
+                frame.detections.set(std::move(detections));
+            }
+        };
+
         std::atomic<float> averageFps = {0.0f};
 
         std::vector<std::shared_ptr<VideoFrame>> batchRes;
@@ -585,6 +947,14 @@ int main(int argc, char *argv[])
 
         size_t perfItersCounter = 0;
 
+        // With -tune_report, every result after the first sampling period, which includes the ramp-up, is measured
+        const bool tuneTrial = !FLAGS_tune_report.empty();
+        bool trialMeasuring = false;
+        timer::time_point trialStart;
+        size_t trialFrames = 0;
+        std::vector<float> trialLatencies;
+
+        bool firstResult = true;
         while (sources.isRunning() || network->isRunning()) {
             bool readData = true;
             while (readData) {
@@ -592,7 +962,20 @@ int main(int argc, char *argv[])
                 if (br.empty()){
                     break; // IEGraph::getBatchData had nothing to process and returned. That means it was stopped
                 }
+                if (firstResult) {
+                    firstResult = false;
+                    slog::info << "Time to first alert-capable frame: " << std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - startupBegin).count() << "ms" << slog::endl;
+                }
                 for (size_t i = 0; i < br.size(); i++){
+                    if (trialMeasuring) {
+                        ++trialFrames;
+                        trialLatencies.push_back(std::chrono::duration_cast<duration>(
+                            std::chrono::steady_clock::now() - br[i]->captureTime).count());
+                    }
+                    if (!trackers.empty()) {
+                        trackFrame(*br[i]);
+                    }
                     // this approach waits for the next input image for sourceIdx. If provided a single image,
                     // it may not show results, especially if -real_input_fps is enabled
                     auto val = static_cast<unsigned int>(br[i]->sourceIdx);
@@ -620,6 +1003,11 @@ int main(int argc, char *argv[])
                 auto frameTime = durMsec / static_cast<float>(fpsCounter);
                 fpsCounter = 0;
                 lastTime = currTime;
+                updateDrivingMode();
+                if (tuneTrial && !trialMeasuring) {
+                    trialMeasuring = true;
+                    trialStart = currTime;
+                }
 
                 if (FLAGS_no_show) {
                     slog::info << "Average Throughput : " << 1000.f / frameTime << " fps" << slog::endl;
@@ -647,10 +1035,80 @@ int main(int argc, char *argv[])
                         statStream << inputStat.readTimes[i] << "ms ";
                     }
                     statStream << std::endl;
-                    statStream << "HW decoding latency: "
-                               << inputStat.decodingLatency << "ms";
+                    statStream << "Decoding latency: ";
+                    for (size_t i = 0; i < inputStat.decodingLatencies.size(); ++i) {
+                        if (0 == (i % 4)) {
+                            statStream << std::endl;
+                        }
+                        statStream << inputStat.decodingLatencies[i] << "ms ";
+                    }
                     statStream << std::endl;
-                    statStream << "Preprocess time: "
+                    statStream << "Frame age / dropped: ";
+                    for (size_t i = 0; i < inputStat.frameAges.size(); ++i) {
+                        if (0 == (i % 4)) {
+                            statStream << std::endl;
+                        }
+                        statStream << inputStat.frameAges[i] << "ms/" << inputStat.droppedFrames[i] << " ";
+                    }
+                    statStream << std::endl;
+                    if (FLAGS_mode_budgets) {
+                        statStream << "Inference budget: ";
+                        for (size_t i = 0; i < cameraBudgets.size(); ++i) {
+                            if (0 == (i % 4)) {
+                                statStream << std::endl;
+                            }
+                            statStream << cameraBudgets[i].priority << "x/";
+                            if (cameraBudgets[i].maxFps > 0.0f) {
+                                statStream << cameraBudgets[i].maxFps << "fps ";
+                            } else {
+                                statStream << "max ";
+                            }
+                        }
+                        statStream << std::endl;
+                    }
+                    if (!keyframeIntervals.empty()) {
+                        statStream << "Detector keyframe interval: ";
+                        for (size_t i = 0; i < keyframeIntervals.size(); ++i) {
+                            if (0 == (i % 4)) {
+                                statStream << std::endl;
+                            }
+                            statStream << keyframeIntervals[i].load() << " ";
+                        }
+                        statStream << std::endl;
+                    }
+                    if (!roiMotion.empty()) {
+                        statStream << "Area motion skipped: ";
+                        for (size_t i = 0; i < roiMotion.size(); ++i) {
+                            if (0 == (i % 4)) {
+                                statStream << std::endl;
+                            }
+                            statStream << roiMotion[i]->takeSkipRate() * 100.0f << "% ";
+                        }
+                        statStream << std::endl;
+                    }
+                    if (FLAGS_motion_threshold > 0.0) {
+                        statStream << "Motion skipped: ";
+                        for (size_t i = 0; i < inputStat.motionSkipRates.size(); ++i) {
+                            if (0 == (i % 4)) {
+                                statStream << std::endl;
+                            }
+                            statStream << inputStat.motionSkipRates[i] * 100.0f << "% ";
+                        }
+                        statStream << std::endl;
+                    }
+                    statStream << "Frame buffer allocations per frame: " << std::setprecision(2)
+                               << inputStat.bufferAllocationsPerFrame << std::setprecision(1);
+                    statStream << std::endl;
+                    auto detectionsStat = detectionsPool.getStats();
+                    statStream << "Pool allocations: frames " << inferStat.videoFramePool.allocations
+                               << "/" << inferStat.videoFramePool.acquired
+                               << ", detections " << detectionsStat.allocations
+                               << "/" << detectionsStat.acquired;
+                    statStream << std::endl;
+                    statStream << "Batch fill: " << inferStat.batchFill * 100.0f << "%, queue delay: "
+                               << inferStat.queueDelay << "ms";
+                    statStream << std::endl;
+                    statStream << "Preprocess time (" << inferStat.preprocessPath << "): "
                                << inferStat.preprocessTime << "ms";
                     statStream << std::endl;
                     statStream << "Plugin latency: "
@@ -661,7 +1119,7 @@ int main(int argc, char *argv[])
                                << "ms" << std::endl;
                     statStream << "Mode: " << vehicle.get_mode_to_string() << std::endl;
                     if (FLAGS_show_calibration) {
-                        for (int i = 0; i < MAX_INPUTS; i++) {
+                        for (size_t i = 0; i < numberOfInputs; i++) {
                             statStream << "Cam " << std::to_string(i + 1) << ": " << std::to_string(camDetections[i]) << std::endl;
                         }
                     }
@@ -673,6 +1131,14 @@ int main(int argc, char *argv[])
             }
         }
 
+        if (tuneTrial) {
+            float trialFps = 0.0f;
+            if (trialMeasuring) {
+                trialFps = static_cast<float>(trialFrames) / std::chrono::duration<float>(timer::now() - trialStart).count();
+            }
+            writeTrialReport(FLAGS_tune_report, trialFps, trialLatencies);
+        }
+
         network.reset();
 
         std::cout << presenter.reportMeans() << '\n';